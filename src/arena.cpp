@@ -0,0 +1,34 @@
+#include "arena.h"
+using namespace std;
+
+namespace json {
+
+void* Arena::allocateSlow(size_t size, size_t align) {
+    // big blocks get a page of their own, the current page keeps being used
+    bool dedicated = size + align > __pageSize / 4;
+    size_t bytes = sizeof(Page) + align + (dedicated ? size : __pageSize);
+    Page* page = static_cast<Page*>(::operator new(bytes));
+    page->next = __pages;
+    __pages = page;
+    ++__pageCount;
+
+    uintptr_t begin = reinterpret_cast<uintptr_t>(page + 1);
+    uintptr_t p = (begin + align - 1) & ~(align - 1);
+    if (!dedicated) {
+        __cur = p + size;
+        __end = begin + align + __pageSize;
+    }
+    return reinterpret_cast<void*>(p);
+}
+
+void Arena::release() noexcept {
+    while (__pages) {
+        Page* next = __pages->next;
+        ::operator delete(__pages);
+        __pages = next;
+    }
+    __cur = __end = 0;
+    __pageCount = 0;
+}
+
+}   // namespace json
@@ -0,0 +1,82 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include "uncopyable.h"
+
+namespace json {
+
+// bump allocator: memory is carved out of large pages and only
+// given back all at once by release() or the dtor.
+class Arena final : uncopyable {
+public:
+    explicit Arena(std::size_t pageSize = 64 * 1024) noexcept
+        : __pages(nullptr), __cur(0), __end(0), __pageSize(pageSize), __pageCount(0) {}
+    ~Arena() { release(); }
+
+    void* allocate(std::size_t size, std::size_t align = alignof(std::max_align_t)) {
+        std::uintptr_t p = (__cur + align - 1) & ~(align - 1);
+        if (p + size > __end) return allocateSlow(size, align);
+        __cur = p + size;
+        return reinterpret_cast<void*>(p);
+    }
+    // free every page, all memory handed out before becomes invalid
+    void release() noexcept;
+
+    std::size_t pageCount() const noexcept { return __pageCount; }
+
+private:
+    struct Page {
+        Page* next;
+    };
+    void* allocateSlow(std::size_t size, std::size_t align);
+
+    Page* __pages;
+    std::uintptr_t __cur;
+    std::uintptr_t __end;
+    std::size_t __pageSize;
+    std::size_t __pageCount;
+};
+
+// allocator for the containers inside Json.
+// a default constructed Allocator uses the global heap, otherwise memory
+// comes from the arena and deallocate() is a no-op.
+template <typename T>
+class Allocator {
+public:
+    using value_type = T;
+
+    Allocator(Arena* arena = nullptr) noexcept : __arena(arena) {}
+    template <typename U>
+    Allocator(const Allocator<U>& rhs) noexcept : __arena(rhs.arena()) {}
+
+    T* allocate(std::size_t n) {
+        if (__arena) return static_cast<T*>(__arena->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, std::size_t) noexcept {
+        if (!__arena) ::operator delete(p);
+    }
+    // a copy never refers to the arena of its source, so it may outlive it
+    Allocator select_on_container_copy_construction() const noexcept { return Allocator(); }
+
+    Arena* arena() const noexcept { return __arena; }
+
+private:
+    Arena* __arena;
+};
+
+template <typename T, typename U>
+bool operator== (const Allocator<T>& lhs, const Allocator<U>& rhs) noexcept {
+    return lhs.arena() == rhs.arena();
+}
+template <typename T, typename U>
+bool operator!= (const Allocator<T>& lhs, const Allocator<U>& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+}   // namespace json
+
+#endif
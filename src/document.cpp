@@ -0,0 +1,39 @@
+#include "document.h"
+#include "jsonException.h"
+#include "parse.h"
+using namespace std;
+
+namespace json {
+
+namespace {
+bool parseInto(Json& root, string& errmsg, Parser& p) {
+    ParseError error;
+    root = p.parse(error);
+    if (error) errmsg = error.str();
+    return !error;
+}
+}   // namespace
+
+bool Document::parse(StringView content, string& errmsg) noexcept {
+    __root = Json(nullptr);
+    __arena.release();
+    Parser p(content, &__arena);
+    return parseInto(__root, errmsg, p);
+}
+
+bool Document::parse(StringView content, ParseError& error) noexcept {
+    __root = Json(nullptr);
+    __arena.release();
+    Parser p(content, &__arena);
+    __root = p.parse(error);
+    return !error;
+}
+
+bool Document::parseInsitu(char* buffer, size_t size, string& errmsg) noexcept {
+    __root = Json(nullptr);
+    __arena.release();
+    Parser p(buffer, size, &__arena);
+    return parseInto(__root, errmsg, p);
+}
+
+}   // namespace json
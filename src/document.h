@@ -0,0 +1,37 @@
+#ifndef _DOCUMENT_H_
+#define _DOCUMENT_H_
+
+#include <string>
+#include "arena.h"
+#include "json.h"
+#include "uncopyable.h"
+
+namespace json {
+
+// a parsed json whose nodes, strings and containers are all allocated from
+// one Arena, released in one shot when the Document is dropped.
+// copies of the root (or of any value in it) are ordinary heap values.
+class Document final : uncopyable {
+public:
+    explicit Document(std::size_t pageSize = 64 * 1024) noexcept : __arena(pageSize), __root(nullptr) {}
+
+    // parse content, replacing the previous root.
+    // if error happens, errmsg storage the error msg and the root is null.
+    bool parse(StringView content, std::string& errmsg) noexcept;
+    // the same, reporting the error as a ParseError
+    bool parse(StringView content, ParseError& error) noexcept;
+    // like Json::parseInsitu, only containers go to the arena
+    bool parseInsitu(char* buffer, std::size_t size, std::string& errmsg) noexcept;
+
+    Json& root() noexcept { return __root; }
+    const Json& root() const noexcept { return __root; }
+    const Arena& arena() const noexcept { return __arena; }
+
+private:
+    Arena __arena;  // declared first, so it outlives __root
+    Json __root;
+};
+
+}   // namespace json
+
+#endif
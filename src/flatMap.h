@@ -0,0 +1,142 @@
+#ifndef _FLATMAP_H_
+#define _FLATMAP_H_
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "jsonString.h"
+#include "stringView.h"
+
+namespace json {
+
+// map from String to V that keeps its members in insertion order, in one
+// vector: small maps are searched by a linear scan, an open-addressing hash
+// index over the members is built once there are more than kIndexThreshold.
+// members are never removed; like std::vector, inserting invalidates
+// iterators and references to members.
+template <typename V, typename Alloc = std::allocator<std::pair<String, V>>>
+class FlatMap {
+public:
+    using key_type = String;
+    using mapped_type = V;
+    using value_type = std::pair<String, V>;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<value_type>;
+    // the key of a member must not be changed through an iterator
+    using iterator = value_type*;
+    using const_iterator = const value_type*;
+
+    static constexpr std::size_t kIndexThreshold = 16;
+
+    FlatMap() = default;
+    explicit FlatMap(const allocator_type& alloc) : __members(alloc), __index(index_allocator(alloc)) {}
+
+    allocator_type get_allocator() const { return __members.get_allocator(); }
+
+    std::size_t size() const noexcept { return __members.size(); }
+    bool empty() const noexcept { return __members.empty(); }
+    iterator begin() noexcept { return __members.data(); }
+    iterator end() noexcept { return __members.data() + __members.size(); }
+    const_iterator begin() const noexcept { return __members.data(); }
+    const_iterator end() const noexcept { return __members.data() + __members.size(); }
+
+    void reserve(std::size_t n) { __members.reserve(n); }
+
+    iterator find(StringView key) noexcept {
+        return const_cast<iterator>(static_cast<const FlatMap*>(this)->find(key));
+    }
+    const_iterator find(StringView key) const noexcept {
+        if (__index.empty()) {
+            for (const value_type& member : __members)
+                if (StringView(member.first) == key) return &member;
+            return end();
+        }
+        std::uint32_t i = __index[slot(key, key.hash())];
+        return i == kEmpty ? end() : &__members[i];
+    }
+    V& at(StringView key) {
+        iterator it = find(key);
+        if (it == end()) throwException(std::out_of_range("FlatMap::at"));
+        return it->second;
+    }
+    const V& at(StringView key) const {
+        const_iterator it = find(key);
+        if (it == end()) throwException(std::out_of_range("FlatMap::at"));
+        return it->second;
+    }
+
+    // adds a member constructed from args, unless there is one with this key already
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace(K&& key, Args&&... args) {
+        StringView view(key);
+        std::size_t hash = 0, pos = 0;
+        if (__index.empty()) {
+            iterator it = find(view);
+            if (it != end()) return {it, false};
+        } else {
+            hash = view.hash();
+            pos = slot(view, hash);
+            if (__index[pos] != kEmpty) return {&__members[__index[pos]], false};
+        }
+        __members.emplace_back(std::piecewise_construct, std::forward_as_tuple(std::forward<K>(key)),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+        std::uint32_t i = static_cast<std::uint32_t>(__members.size() - 1);
+        // the index stays at most half full
+        if (2 * __members.size() > __index.size()) {
+            if (__members.size() > kIndexThreshold) rebuildIndex();
+        } else __index[pos] = i;
+        return {&__members.back(), true};
+    }
+
+private:
+    using index_allocator = typename std::allocator_traits<Alloc>::template rebind_alloc<std::uint32_t>;
+    static constexpr std::uint32_t kEmpty = UINT32_MAX;
+
+    // slot of the member whose key is key, or the empty slot where it would go
+    std::size_t slot(StringView key, std::size_t hash) const noexcept {
+        std::size_t mask = __index.size() - 1;
+        for (std::size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+            std::uint32_t i = __index[pos];
+            if (i == kEmpty || StringView(__members[i].first) == key) return pos;
+        }
+    }
+    void rebuildIndex() {
+        std::size_t slots = 2 * kIndexThreshold;
+        while (slots < 4 * __members.size()) slots *= 2;
+        __index.assign(slots, kEmpty);
+        for (std::uint32_t i = 0; i != __members.size(); ++i) {
+            StringView key(__members[i].first);
+            __index[slot(key, key.hash())] = i;
+        }
+    }
+
+    std::vector<value_type, allocator_type> __members;
+    // positions in __members, by hash of their key; empty below the threshold
+    std::vector<std::uint32_t, index_allocator> __index;
+};
+
+template <typename V, typename Alloc>
+constexpr std::size_t FlatMap<V, Alloc>::kIndexThreshold;
+template <typename V, typename Alloc>
+constexpr std::uint32_t FlatMap<V, Alloc>::kEmpty;
+
+// same members, in any order
+template <typename V, typename Alloc>
+bool operator== (const FlatMap<V, Alloc>& lhs, const FlatMap<V, Alloc>& rhs) {
+    if (lhs.size() != rhs.size()) return false;
+    for (const auto& member : lhs) {
+        auto it = rhs.find(member.first);
+        if (it == rhs.end() || !(it->second == member.second)) return false;
+    }
+    return true;
+}
+template <typename V, typename Alloc>
+bool operator!= (const FlatMap<V, Alloc>& lhs, const FlatMap<V, Alloc>& rhs) {
+    return !(lhs == rhs);
+}
+
+}   // namespace json
+
+#endif
@@ -1,34 +1,178 @@
 #include "json.h"
-#include "jsonValue.h"
+#include "jsonException.h"
+#include "number.h"
+#include "parallel.h"
 #include "parse.h"
+#include "scan.h"
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <thread>
 using namespace std;
 
 namespace json{
 
+namespace {
+
+// array/object payloads live in the arena their allocator refers to, or on the heap
+// if there is none. those on the heap are shared by the copies of a Json and copied
+// on write, those in an arena belong to one Json (copies of it go to the heap).
+template <typename T>
+struct Shared final : T {
+    explicit Shared(const typename T::allocator_type& alloc) : T(alloc) {}
+    explicit Shared(const T& val) : T(val) {}
+    explicit Shared(T&& val) : T(std::move(val)) {}
+    template <typename It>
+    Shared(It first, It last) : T(first, last) {}
+
+    std::atomic<std::uint32_t> refs{1};
+    // a reference into the payload was handed out, copies must not share it
+    bool unshareable = false;
+};
+template <typename T>
+Shared<T>* shared(T* p) noexcept {
+    return static_cast<Shared<T>*>(p);
+}
+
+template <typename T>
+T* newPayload(Arena* arena) {
+    if (!arena) return new Shared<T>(typename T::allocator_type());
+    return new (arena->allocate(sizeof(Shared<T>), alignof(Shared<T>))) Shared<T>(typename T::allocator_type(arena));
+}
+// payload taking val over, in the arena of its allocator if it has one
+template <typename T>
+T* movePayload(T&& val) {
+    Arena* arena = val.get_allocator().arena();
+    if (!arena) return new Shared<T>(std::move(val));
+    return new (arena->allocate(sizeof(Shared<T>), alignof(Shared<T>))) Shared<T>(std::move(val));
+}
+template <typename T>
+T* copyPayload(T* p) {
+    Shared<T>* s = shared(p);
+    if (s->get_allocator().arena() || s->unshareable) return new Shared<T>(static_cast<const T&>(*p));
+    s->refs.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+template <typename T>
+void deletePayload(T* p) noexcept {
+    Shared<T>* s = shared(p);
+    if (s->get_allocator().arena()) s->~Shared<T>();   // memory is released with the arena
+    else if (s->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete s;
+}
+// the payload, copied first if it is shared. a reference into it is about
+// to be handed out, from now on copies of the Json copy it.
+template <typename T>
+T* mutablePayload(T*& p) {
+    if (shared(p)->refs.load(std::memory_order_acquire) != 1) {
+        T* copy = new Shared<T>(static_cast<const T&>(*p));
+        deletePayload(p);
+        p = copy;
+    }
+    shared(p)->unshareable = true;
+    return p;
+}
+
+void writeString(Writer& writer, StringView str){
+    writer.put('\"');
+    const char* p = str.data();
+    const char* end = p + str.size();
+    for (;;){
+        // copy runs of chars that need no escape as a whole
+        const char* run = scanString(p, end);
+        writer.write(p, run - p);
+        if (run == end) break;
+        switch (*run) {
+            case '\"' : writer.write("\\\"", 2); break;
+            case '\\': writer.write("\\\\", 2); break;
+            case '\b': writer.write("\\b", 2); break;
+            case '\f': writer.write("\\f", 2); break;
+            case '\n': writer.write("\\n", 2); break;
+            case '\r': writer.write("\\r", 2); break;
+            case '\t': writer.write("\\t", 2); break;
+            default : {
+                // other control chars
+                static const char hex[] = "0123456789ABCDEF";
+                char buf[6] = {'\\', 'u', '0', '0', hex[*run >> 4], hex[*run & 0xF]};
+                writer.write(buf, 6);
+            }
+        }
+        p = run + 1;
+    }
+    writer.put('\"');
+}
+
+// the result of p, or null and the message of its error in errmsg
+Json parseWith(Parser& p, string& errmsg) {
+    ParseError error;
+    Json json = p.parse(error);
+    if (error) errmsg = error.str();
+    return json;
+}
+}   // namespace
+
 // ctor
-Json::Json(nullptr_t) : __value(make_unique<JsonNull>(nullptr)) {}
-Json::Json(bool val) : __value(make_unique<JsonBool>(val)) {}
-Json::Json(double val) : __value(make_unique<JsonDouble>(val)) {}
-Json::Json(const string& val) : __value(make_unique<JsonString>(val)) {}
-Json::Json(const array_t& val) : __value(make_unique<JsonArray>(val)) {}
-Json::Json(const object_t& val) : __value(make_unique<JsonObject>(val)) {}
-Json::Json(const Json& rhs) {
-    switch (rhs.type()){
-        case JsonType::tNULL : __value = make_unique<JsonNull>(nullptr); break;
-        case JsonType::tBOOL : __value = make_unique<JsonBool>(rhs.toBool()); break;
-        case JsonType::tNUM : __value = make_unique<JsonDouble>(rhs.toDouble()); break;
-        case JsonType::tSTR : __value = make_unique<JsonString>(rhs.toString()); break;
-        case JsonType::tARRAY : __value = make_unique<JsonArray>(rhs.toArray()); break;
-        case JsonType::tOBJ : __value = make_unique<JsonObject>(rhs.toObject()); break;
+Json::Json(nullptr_t) : __type(JsonType::tNULL), __bits{0, 0, 0} {}
+Json::Json(bool val) : __type(JsonType::tBOOL), __bits{0, 0, 0} { __bool = val; }
+Json::Json(double val) : __type(JsonType::tNUM), __bits{0, 0, 0} { __num = val; }
+Json::Json(long long val) : __type(JsonType::tNUM), __numType(nINT64), __bits{0, 0, 0} { __int = val; }
+Json::Json(unsigned long long val) : __type(JsonType::tNUM), __bits{0, 0, 0} {
+    if (val <= INT64_MAX) {
+        __numType = nINT64;
+        __int = static_cast<int64_t>(val);
+    } else {
+        __numType = nUINT64;
+        __uint = val;
     }
 }
-Json::Json(Json&& rhs) noexcept : __value(std::move(rhs.__value)){
-    rhs.__value = nullptr;
+Json::Json(StringView val) : __type(JsonType::tSTR), __str(val) {}
+Json::Json(String&& val) noexcept : __type(JsonType::tSTR), __str(std::move(val)) {}
+Json::Json(const array_t& val) : __type(JsonType::tARRAY), __arr(new Shared<array_t>(val)) {}
+Json::Json(const object_t& val) : __type(JsonType::tOBJ), __obj(new Shared<object_t>(val)) {}
+Json::Json(array_t&& val) : __type(JsonType::tARRAY), __arr(movePayload(std::move(val))) {}
+Json::Json(object_t&& val) : __type(JsonType::tOBJ), __obj(movePayload(std::move(val))) {}
+Json::Json(const vector<Json>& val) : __type(JsonType::tARRAY), __arr(new Shared<array_t>(val.begin(), val.end())) {}
+Json::Json(vector<Json>&& val)
+    : __type(JsonType::tARRAY), __arr(new Shared<array_t>(make_move_iterator(val.begin()), make_move_iterator(val.end()))) {}
+Json::Json(const unordered_map<string, Json>& val) : __type(JsonType::tOBJ), __obj(newPayload<object_t>(nullptr)) {
+    for (auto& p : val) __obj->emplace(String(p.first), p.second);
+}
+Json::Json(JsonType type, Arena* arena) : __type(type), __bits{0, 0, 0} {
+    switch (type){
+        case JsonType::tSTR : new (&__str) String(); break;
+        case JsonType::tARRAY : __arr = newPayload<array_t>(arena); break;
+        case JsonType::tOBJ : __obj = newPayload<object_t>(arena); break;
+        default : break;
+    }
+}
+Json::Json(const Json& rhs) : __type(rhs.__type), __numType(rhs.__numType), __bits{0, 0, 0} {
+    switch (rhs.__type){
+        case JsonType::tNULL : 
+        case JsonType::tBOOL : 
+        case JsonType::tNUM : __bits[0] = rhs.__bits[0]; break;
+        case JsonType::tSTR : new (&__str) String(rhs.__str); break;
+        case JsonType::tARRAY : __arr = copyPayload(rhs.__arr); break;
+        case JsonType::tOBJ : __obj = copyPayload(rhs.__obj); break;
+    }
+}
+Json::Json(Json&& rhs) noexcept
+    : __type(rhs.__type), __numType(rhs.__numType), __bits{rhs.__bits[0], rhs.__bits[1], rhs.__bits[2]} {
+    // steal the payload, leave rhs as null
+    rhs.__type = JsonType::tNULL;
 }
 
 // dtor 
-Json::~Json() {}
+Json::~Json() {
+    switch (__type){
+        case JsonType::tSTR : __str.~String(); break;
+        case JsonType::tARRAY : deletePayload(__arr); break;
+        case JsonType::tOBJ : deletePayload(__obj); break;
+        default : break;
+    }
+}
 
 // copy op=
 Json& Json::operator=(Json rhs){
@@ -37,114 +181,278 @@ Json& Json::operator=(Json rhs){
 }
 void Json::swap(Json& rhs) noexcept{
     // copy-and-swap idiom
+    // every payload (String included) can be moved by copying its bytes
     using std::swap;
-    swap(__value, rhs.__value);
+    swap(__type, rhs.__type);
+    swap(__numType, rhs.__numType);
+    swap(__bits, rhs.__bits);
+}
+
+bool Json::get(bool& val) const noexcept {
+    if (__type != JsonType::tBOOL) return false;
+    val = __bool;
+    return true;
+}
+bool Json::get(double& val) const noexcept {
+    if (__type != JsonType::tNUM) return false;
+    switch (__numType){
+        case nINT64 : val = static_cast<double>(__int); break;
+        case nUINT64 : val = static_cast<double>(__uint); break;
+        default : val = __num;
+    }
+    return true;
+}
+bool Json::get(int64_t& val) const noexcept {
+    if (__type != JsonType::tNUM) return false;
+    switch (__numType){
+        case nINT64 : val = __int; return true;
+        case nUINT64 : return false;
+        default :
+            // doubles in [-2^63, 2^63) without fraction
+            if (!(__num >= -9223372036854775808.0 && __num < 9223372036854775808.0 && __num == std::trunc(__num)))
+                return false;
+            val = static_cast<int64_t>(__num);
+            return true;
+    }
+}
+bool Json::get(uint64_t& val) const noexcept {
+    if (__type != JsonType::tNUM) return false;
+    switch (__numType){
+        case nINT64 :
+            if (__int < 0) return false;
+            val = static_cast<uint64_t>(__int);
+            return true;
+        case nUINT64 : val = __uint; return true;
+        default :
+            // doubles in [0, 2^64) without fraction
+            if (!(__num >= 0 && __num < 18446744073709551616.0 && __num == std::trunc(__num))) return false;
+            val = static_cast<uint64_t>(__num);
+            return true;
+    }
+}
+bool Json::get(StringView& val) const noexcept {
+    if (__type != JsonType::tSTR) return false;
+    val = __str;
+    return true;
+}
+bool Json::get(const array_t*& val) const noexcept {
+    if (__type != JsonType::tARRAY) return false;
+    val = __arr;
+    return true;
+}
+bool Json::get(const object_t*& val) const noexcept {
+    if (__type != JsonType::tOBJ) return false;
+    val = __obj;
+    return true;
 }
 
 bool Json::toBool() const {
-    // __valueunique_ptr<JsonValue>ǵJsonValue::toBool()
-    return __value->toBool();
+    bool val;
+    if (!get(val)) throwException(JsonException("not a bool"));
+    return val;
 }
 double Json::toDouble() const {
-    return __value->toDouble();
+    double val;
+    if (!get(val)) throwException(JsonException("not a number"));
+    return val;
 }
-const string& Json::toString() const {
-    return __value->toString();
+int64_t Json::toInt64() const {
+    int64_t val;
+    if (!get(val)) throwException(JsonException(__type == JsonType::tNUM ? "not an int64" : "not a number"));
+    return val;
+}
+uint64_t Json::toUint64() const {
+    uint64_t val;
+    if (!get(val)) throwException(JsonException(__type == JsonType::tNUM ? "not an uint64" : "not a number"));
+    return val;
+}
+StringView Json::toString() const {
+    if (__type != JsonType::tSTR) throwException(JsonException("not a string"));
+    return __str;
 }
 const Json::array_t& Json::toArray() const {
-    return __value->toArray();
+    if (__type != JsonType::tARRAY) throwException(JsonException("not an array"));
+    return *__arr;
 }
 const Json::object_t& Json::toObject() const {
-    return __value->toObject();
+    if (__type != JsonType::tOBJ) throwException(JsonException("not an object"));
+    return *__obj;
 }
 
 JsonType Json::type() const noexcept { 
-    // JsonValue::type()
-    return __value->type(); 
+    return __type; 
 }
 bool Json::isNull() const noexcept { return type() == JsonType::tNULL; }
 bool Json::isBool() const noexcept { return type() == JsonType::tBOOL; }
 bool Json::isNumber() const noexcept { return type() == JsonType::tNUM; }
+bool Json::isInteger() const noexcept { return type() == JsonType::tNUM && __numType != nDOUBLE; }
 bool Json::isString() const noexcept { return type() == JsonType::tSTR; }
 bool Json::isArray() const noexcept { return type() == JsonType::tARRAY; }
 bool Json::isObject() const noexcept { return type() == JsonType::tOBJ; }
-// ڵJsonValueеop[]
-Json& Json::operator[](size_t i) { return __value->operator[](i); }
-const Json& Json::operator[](size_t i) const { return __value->operator[](i); }
-Json& Json::operator[](const string& i) { return __value->operator[](i); }
-const Json& Json::operator[](const string& i) const { return __value->operator[](i); }
 
-size_t Json::size() const noexcept { return __value->size(); }
+Json& Json::operator[](size_t i) {
+    if (__type != JsonType::tARRAY) throwException(JsonException("not an array"));
+    return (*mutablePayload(__arr))[i];
+}
+const Json& Json::operator[](size_t i) const {
+    if (__type != JsonType::tARRAY) throwException(JsonException("not an array"));
+    return (*__arr)[i];
+}
+Json& Json::operator[](const string& i) {
+    if (__type != JsonType::tOBJ) throwException(JsonException("not an object"));
+    return mutablePayload(__obj)->at(String::view(i));
+}
+const Json& Json::operator[](const string& i) const {
+    if (__type != JsonType::tOBJ) throwException(JsonException("not an object"));
+    return __obj->at(String::view(i));
+}
 
-Json Json::parse(const string& content, string& errmsg) noexcept{
-    try{
-        Parser p(content);
-        return p.parse();
-    } catch (JsonException& err) {
-        errmsg = err.what();
-        return Json(nullptr);
-    }
+const Json* Json::find(size_t i) const noexcept {
+    if (__type != JsonType::tARRAY || i >= __arr->size()) return nullptr;
+    return &(*__arr)[i];
+}
+const Json* Json::find(StringView key) const noexcept {
+    if (__type != JsonType::tOBJ) return nullptr;
+    object_t::const_iterator it = __obj->find(key);
+    return it != __obj->end() ? &it->second : nullptr;
 }
 
-string Json::serialize() const noexcept{
-    switch (__value->type()){
-        case JsonType::tNULL : return "null";
-        case JsonType::tBOOL : return __value->toBool() ? "true" : "false";
-        case JsonType::tNUM : 
-            char buf[32];
-            snprintf(buf, sizeof(buf), "%.17g", __value->toDouble());
-            return buf;
-        case JsonType::tSTR : return serializeString();
-        case JsonType::tARRAY : return serializeArray();
-        case JsonType::tOBJ : return serializeObject(); 
+size_t Json::size() const noexcept {
+    switch (__type){
+        case JsonType::tARRAY : return __arr->size();
+        case JsonType::tOBJ : return __obj->size();
+        default : return 0;
     }
-    assert(0);
 }
 
-string Json::serializeString() const noexcept{
-    string ret = "\"";
-    for (auto e : __value->toString()){
-        switch (e) {
-            case '\"' : ret += "\\\""; break;
-            case '\\': ret += "\\\\"; break;
-            case '\b': ret += "\\b"; break;
-            case '\f': ret += "\\f"; break;
-            case '\n': ret += "\\n"; break;
-            case '\r': ret += "\\r"; break;
-            case '\t': ret += "\\t"; break;
-            default : 
-                if (static_cast<unsigned char>(e) < 0x20) {
-                    char buf[7];
-                    sprintf(buf, "\\u%04X", e);
-                    ret += buf;
-                }else ret += e;
+Json Json::parse(StringView content, string& errmsg) noexcept{
+    Parser p(content);
+    return parseWith(p, errmsg);
+}
+
+Json Json::parse(StringView content, ParseError& error) noexcept{
+    Parser p(content);
+    return p.parse(error);
+}
+
+bool Json::validate(StringView content, ParseError& error) noexcept{
+    Parser p(content);
+    return p.validate(error);
+}
+
+Json Json::parse(StringView content, string& errmsg, KeyPool& keys) noexcept{
+    Parser p(content);
+    p.setKeyPool(&keys);
+    return parseWith(p, errmsg);
+}
+
+Json Json::parseInsitu(char* buffer, size_t size, string& errmsg) noexcept{
+    Parser p(buffer, size);
+    return parseWith(p, errmsg);
+}
+
+constexpr size_t Json::kParallelTaskSize;
+
+Json Json::parseParallel(StringView content, string& errmsg, unsigned threads) noexcept{
+    if (!threads) threads = max(1u, thread::hardware_concurrency());
+    // the Parser stops at a NUL char
+    if (const void* nul = memchr(content.data(), '\0', content.size()))
+        content = StringView(content.data(), static_cast<const char*>(nul) - content.data());
+    const char* begin = content.data();
+    const char* end = begin + content.size();
+    JSON_TRY{
+        vector<size_t> seps;
+        if (threads > 1 && arraySeparators(begin, end, seps) && skipWhitespace(begin + seps.back() + 1, end) == end) {
+            // element i is between seps[i] and seps[i + 1], a task is a run of them
+            vector<size_t> tasks{0};
+            for (size_t i = 1; i + 1 < seps.size(); ++i)
+                if (seps[i] - seps[tasks.back()] >= kParallelTaskSize) tasks.push_back(i);
+            tasks.push_back(seps.size() - 1);
+            if (tasks.size() > 2) {
+                Json result(JsonType::tARRAY, nullptr);
+                result.__arr->assign(seps.size() - 1, Json(nullptr));
+                atomic<bool> failed(false);
+                forEachParallel(min<size_t>(threads, tasks.size() - 1), tasks.size() - 1, [&](size_t t) {
+                    for (size_t i = tasks[t]; i != tasks[t + 1] && !failed; ++i) {
+                        Parser p(StringView(begin + seps[i] + 1, seps[i + 1] - seps[i] - 1));
+                        ParseError error;
+                        (*result.__arr)[i] = p.parse(error);
+                        if (error) failed = true;
+                    }
+                });
+                // the error is reported by the serial parser below, with its context
+                if (!failed) return result;
+            }
         }
+        Parser p(content);
+        return parseWith(p, errmsg);
+    } JSON_CATCH(std::exception&) {
+        // memory ran out
+        return parse(content, errmsg);
     }
-    ret += "\"";
-    return ret;
 }
 
-string Json::serializeArray() const noexcept{
-    string ret = "[";
-    for (size_t i = 0; i < __value->size(); ++i){
-        if (i > 0) ret += ",";
-        ret += (*this)[i].serialize();
-    }
-    ret += "]";
+string Json::serialize() const noexcept{
+    string ret;
+    serialize(ret);
     return ret;
 }
 
-string Json::serializeObject() const noexcept{
-    string ret = "{";
-    bool first = 1;
-    for (const pair<string, Json>& p : __value->toObject()){
-        if (first) first = 0;
-        else ret += ", ";
-        ret += "\"" + p.first + "\"";
-        ret += ": ";
-        ret += p.second.serialize();
+void Json::serialize(string& out) const{
+    StringWriter writer(out);
+    serialize(writer);
+}
+
+void Json::serialize(Writer& writer) const{
+    switch (__type){
+        case JsonType::tNULL : writer.write("null", 4); break;
+        case JsonType::tBOOL : __bool ? writer.write("true", 4) : writer.write("false", 5); break;
+        case JsonType::tNUM : {
+            // formatted aside, so that chunked writers get full chunks
+            char buf[32];
+            char* end;
+            switch (__numType){
+                case nINT64 : end = formatInteger(__int, buf); break;
+                case nUINT64 : end = formatInteger(__uint, buf); break;
+                default : end = formatDouble(__num, buf); break;
+            }
+            writer.write(buf, end - buf);
+            break;
+        }
+        case JsonType::tSTR : writeString(writer, __str); break;
+        case JsonType::tARRAY : 
+            writer.write("[ ", 2);
+            for (size_t i = 0; i < __arr->size(); ++i){
+                if (i > 0) writer.write(", ", 2);
+                (*__arr)[i].serialize(writer);
+            }
+            writer.write(" ]", 2);
+            break;
+        case JsonType::tOBJ : {
+            writer.write("{ ", 2);
+            bool first = 1;
+            for (const object_t::value_type& p : *__obj){
+                if (first) first = 0;
+                else writer.write(", ", 2);
+                writeString(writer, p.first);
+                writer.write(": ", 2);
+                p.second.serialize(writer);
+            }
+            writer.write(" }", 2);
+            break;
+        }
     }
-    return ret + " }";
+}
+
+ostream& operator<< (ostream& os, const Json& json){
+    // the padding of os (setw) applies to the whole text, as for a string
+    if (os.width()) return os << json.serialize();
+    // small values go out without allocating, larger ones a buffer at a time
+    char buffer[1024];
+    OstreamWriter writer(os, buffer, sizeof(buffer));
+    json.serialize(writer);
+    writer.flush();
+    return os;
 }
 
 bool operator==(const Json& lhs, const Json& rhs) noexcept {
@@ -152,10 +460,15 @@ bool operator==(const Json& lhs, const Json& rhs) noexcept {
     switch (lhs.type()){
         case JsonType::tNULL: return true;
         case JsonType::tBOOL: return lhs.toBool() == rhs.toBool();
-        case JsonType::tNUM: return lhs.toDouble() == rhs.toDouble();
+        case JsonType::tNUM: 
+            // nINT64 holds every integer that fits it, so integers of different kinds never match
+            if (lhs.isInteger() && rhs.isInteger()) 
+                return lhs.__numType == rhs.__numType && lhs.__uint == rhs.__uint;
+            return lhs.toDouble() == rhs.toDouble();
         case JsonType::tSTR: return lhs.toString() == rhs.toString();
-        case JsonType::tARRAY: return lhs.toArray() == rhs.toArray();
-        case JsonType::tOBJ: return lhs.toObject() == rhs.toObject();
+        // copies share their payload
+        case JsonType::tARRAY: return lhs.__arr == rhs.__arr || lhs.toArray() == rhs.toArray();
+        case JsonType::tOBJ: return lhs.__obj == rhs.__obj || lhs.toObject() == rhs.toObject();
     }
     assert(0);
 }
@@ -1,15 +1,21 @@
 #ifndef _JSON_H_
 #define _JSON_H_
 
+#include <cstdint>
 #include <iosfwd>
-#include <memory>
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include "arena.h"
+#include "flatMap.h"
+#include "jsonString.h"
+#include "parseError.h"
+#include "stringView.h"
+#include "writer.h"
 
 namespace json {
 
-class JsonValue;
+class KeyPool;
 
 enum JsonType{
     tNULL,
@@ -23,27 +29,75 @@ enum JsonType{
 class Json final {
 public:
     // define alias
-    using array_t = std::vector<Json>;
-    using object_t = std::unordered_map<std::string, Json>;
+    // containers take an Allocator so that a Document can put them in its Arena
+    using array_t = std::vector<Json, Allocator<Json>>;
+    // members of an object keep the order in which they were added (that of the document)
+    using object_t = FlatMap<Json, Allocator<std::pair<String, Json>>>;
 
     // parse string to json
+    // content may be any buffer (std::string, char* + size, mmap'd file ...),
+    // it does not need to be NUL-terminated.
     // if error happens, errmsg storage the error msg.
-    static Json parse(const std::string& content, std::string& errmsg) noexcept;
+    static Json parse(StringView content, std::string& errmsg) noexcept;
+    // the same, reporting the error as its code and position instead of a message
+    // (error is OK if there is none)
+    static Json parse(StringView content, ParseError& error) noexcept;
+    // the same, taking object keys from keys (see KeyPool)
+    static Json parse(StringView content, std::string& errmsg, KeyPool& keys) noexcept;
+    // only check that content is valid json, including the UTF-8 of its strings,
+    // without building or allocating anything (see Parser::validate())
+    static bool validate(StringView content, ParseError& error) noexcept;
+    // parse in-situ: escapes are decoded in place in buffer, and the string
+    // values and keys of the result are views into it.
+    // buffer must outlive the result (copies of the result are independent).
+    static Json parseInsitu(char* buffer, std::size_t size, std::string& errmsg) noexcept;
+    // same result and errors as parse(), but if the root is a large array its
+    // elements are parsed on several threads (threads = 0: one per hardware thread).
+    // element boundaries are found by a structural pre-scan; on any error the
+    // document is parsed again serially, to report the error in the same way.
+    static Json parseParallel(StringView content, std::string& errmsg, unsigned threads = 0) noexcept;
+    // chars of array elements given to each thread at a time by parseParallel()
+    static constexpr std::size_t kParallelTaskSize = 1 << 16;
     // serialize json to string
-    // ʵserialize__valueת
+    // 实现serialize，根据__type类型转换
     std::string serialize() const noexcept;
+    // append the serialized json to out
+    void serialize(std::string& out) const;
+    // write the serialized json to writer, without flushing it
+    void serialize(Writer& writer) const;
 
     // ctor
     explicit Json(std::nullptr_t);
     explicit Json(bool);
     explicit Json(double);
-    explicit Json(int val) : Json(1.0 * val) {};
-    explicit Json(const std::string&);
+    // integers are stored as 64-bit integers, not converted to double
+    explicit Json(int val) : Json(static_cast<long long>(val)) {};
+    explicit Json(long val) : Json(static_cast<long long>(val)) {};
+    explicit Json(long long);
+    explicit Json(unsigned val) : Json(static_cast<unsigned long long>(val)) {};
+    explicit Json(unsigned long val) : Json(static_cast<unsigned long long>(val)) {};
+    explicit Json(unsigned long long);
+    explicit Json(StringView);
+    explicit Json(const std::string& str) : Json(StringView(str)) {};
     // special ctor for C-style string
     // without this ctor, ' Json("xxxx") ' call Json(bool). 
-    explicit Json(const char* cstr) : Json(std::string(cstr)) {};
+    explicit Json(const char* cstr) : Json(StringView(cstr)) {};
     explicit Json(const array_t&);
     explicit Json(const object_t&);
+    // take the container over, elements are neither copied nor moved.
+    // a container allocated from an Arena stays in it
+    explicit Json(array_t&&);
+    explicit Json(object_t&&);
+    // ctor from the standard containers, elements are copied
+    explicit Json(const std::vector<Json>&);
+    // elements are moved
+    explicit Json(std::vector<Json>&&);
+    explicit Json(const std::unordered_map<std::string, Json>&);
+    // O(1): copies share the strings, arrays and objects on the heap (reference
+    // counted, copies may be used from different threads), a shared array or
+    // object is copied by the first non-const operator[] that accesses it.
+    // values in an Arena, and arrays or objects a non-const operator[] has given
+    // a reference into, are copied (their elements and members are shared).
     Json(const Json&);
     Json(Json&&) noexcept;
 
@@ -61,6 +115,8 @@ public:
     bool isBool() const noexcept;
     // Is the current value a number value?
     bool isNumber() const noexcept;
+    // Is the current value a number stored as a 64-bit integer?
+    bool isInteger() const noexcept;
     // Is the current value a string value?
     bool isString() const noexcept;
     // Is the current value a array value?
@@ -68,17 +124,38 @@ public:
     // Is the current value a object value?
     bool isObject() const noexcept;
 
+    // Stores the value in val and returns true if it has the type (and for integers,
+    // an exact value in the range) of val. the same conversions as the to*()
+    // below, without exceptions: false and val unchanged otherwise
+    bool get(bool& val) const noexcept;
+    bool get(double& val) const noexcept;
+    bool get(std::int64_t& val) const noexcept;
+    bool get(std::uint64_t& val) const noexcept;
+    bool get(StringView& val) const noexcept;
+    bool get(const array_t*& val) const noexcept;
+    bool get(const object_t*& val) const noexcept;
+
     // Converts the JSON value to a C++ boolean, if and only if it is a boolean
     bool toBool() const;
     // Converts the JSON value to a C++ double, if and only if it is a double
+    // (integers are converted, which may round those above 2^53)
     double toDouble() const;
+    // Converts the JSON value to a C++ int64, if and only if it is a number with an exact int64 value
+    std::int64_t toInt64() const;
+    // Converts the JSON value to a C++ uint64, if and only if it is a number with an exact uint64 value
+    std::uint64_t toUint64() const;
     // Converts the JSON value to a C++ string, if and only if it is a string
-    const std::string& toString() const;
+    // the view is valid as long as this value is alive and unchanged
+    StringView toString() const;
     // Converts the JSON value to a json array, if and only if it is an array
     const array_t& toArray() const;
     // Converts the JSON value to a json object, if and only if it is an object
     const object_t& toObject() const;
 
+    // Accesses a field of a JSON array, nullptr if it is not an array or i is out of range
+    const Json* find(std::size_t i) const noexcept;
+    // Accesses a field of a JSON object, nullptr if it is not an object or has no such member
+    const Json* find(StringView key) const noexcept;
     // Accesses a field of a JSON array
     Json& operator[](std::size_t);
     // Accesses a field of a JSON array
@@ -89,18 +166,18 @@ public:
     const Json& operator[](const std::string&) const;
 
     /* 
-        C++ıÿǾ̬ĳԱĲбһthisָ룬
-    ΪжĴڴоһݣthisָĹ˭Ա
-    óԱthisָָ˭Ӷ˭ݡconstĳԱ
-    thisָǲͬģ
-        constĳԱthisָ(*const A*)͵ģconstĳԱthisָ(A*)͵ġ
+        C++的编译器会在你的每个非静态的成员函数的参数列表中增加一个this指针，
+    因为所有对象的代码在内存中就一份，this指针的功能是谁调用这个成员函数，
+    该成员函数的这个this指针就指向谁，从而处理谁的数据。带不带const的成员函数
+    的this指针是不同的：
+        const的成员函数的this指针是(*const A*)类型的；不带const的成员函数的this指针是(A*)类型的。
     */
     /*
-        ǵconstεĶĺãҲ˵׳Ա
-    һ׸constεĶ󣨱糣ַãһ׸ûconstεĶáconst
-    ĸòغ䷵ֵҲӦconstģͻֿͨ޸const©
+        考虑到const修饰的对象的函数调用，也就是说必须做两套成员函数，
+    一套给有const修饰的对象（比如常量字符串）用，一套给没有const修饰的对象用。对于const
+    的该操作符重载函数其返回值也应该是const的，否则就会出现可以通过其修改const对象的漏洞。
 
-    磺 Ϊ˸Stringṩһ[]дָλõַҪṩԷֱԷconst Stringconst Stringṩ֧֣
+    例如： 为了给String提供一个[]操作符来读写指定位置的字符，需要提供如下两个函数，以分别对非const String对象和const String对象提供支持：
     char& operator[](int posion) { return data[posion]; };
     const char& operator[](int posion) const { return data[posion]; }
     */
@@ -108,21 +185,39 @@ public:
     std::size_t size() const noexcept;
 
 private:
-    // copy-and-swap idiom رcopy-assignment operatorʵ
+    friend class Parser;
+    friend class DomBuilder;
+    friend bool operator== (const Json&, const Json&) noexcept;
+    // empty string/array/object whose storage comes from arena (heap if nullptr)
+    Json(JsonType, Arena*);
+    explicit Json(String&&) noexcept;
+
+    // copy-and-swap idiom 特别针对copy-assignment operator的实现
     void swap(Json&) noexcept; 
-    // only used internally by serialize() 
-    std::string serializeString() const noexcept;
-    std::string serializeArray() const noexcept;
-    std::string serializeObject() const noexcept;
 
-    std::unique_ptr<JsonValue> __value;
+    // tagged union: null/bool/number and short strings are stored inline,
+    // longer strings and array/object are stored out of line.
+    JsonType __type;
+    // representation of a tNUM. integers that fit in int64 are always nINT64
+    enum NumType : std::uint8_t { nDOUBLE, nINT64, nUINT64 };
+    NumType __numType = nDOUBLE;
+    union {
+        std::uint64_t __bits[3];   // raw payload, used to move/swap any member
+        bool __bool;
+        double __num;
+        std::int64_t __int;
+        std::uint64_t __uint;
+        String __str;
+        array_t* __arr;
+        object_t* __obj;
+    };
 };
 
 // io func 
-// Ҫͷļж庯ĻҪinlineļθͷļͳ֡ظ塱
-inline std::ostream& operator<< (std::ostream& os, const Json& json){
-    return os << json.serialize();
-}
+// 要在头文件中定义函数的话，需要加inline，否则其他文件包含多次该头文件就出现“重复定义”错误。
+// streams the serialized json in chunks, without building it in memory
+// (unless a width is set on os: the text is then padded like a string)
+std::ostream& operator<< (std::ostream& os, const Json& json);
 
 // compare func
 bool operator== (const Json&, const Json&) noexcept;
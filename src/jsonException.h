@@ -1,9 +1,26 @@
 #ifndef _JSONEXCEPTION_H_
 #define _JSONEXCEPTION_H_
 
+#include <cstdio>
+#include <cstdlib>
 #include <stdexcept>
+
+// exceptions may be turned off (-fno-exceptions, JSON_NO_EXCEPTIONS in cmake):
+// what would be thrown then prints its message and aborts. the functions that
+// report errors instead (parse() taking a ParseError, get(), find()) work the
+// same either way, and are the ones to use in such a build.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define JSON_EXCEPTIONS 1
+#define JSON_TRY try
+#define JSON_CATCH(exception) catch (exception)
+#else
+#define JSON_EXCEPTIONS 0
+#define JSON_TRY if (true)
+#define JSON_CATCH(exception) else
+#endif
+
 namespace json{
-    
+
     class JsonException final : public std::runtime_error{
     public:
         explicit JsonException(const std::string& errmsg) : runtime_error(errmsg) {}
@@ -12,6 +29,17 @@ namespace json{
         }
     };
 
+    // throw exception, or abort without exceptions
+    template <typename Exception>
+    [[noreturn]] void throwException(const Exception& exception) {
+#if JSON_EXCEPTIONS
+        throw exception;
+#else
+        std::fprintf(stderr, "json: %s\n", exception.what());
+        std::abort();
+#endif
+    }
+
 }   // namespace json
 
-#endif
\ No newline at end of file
+#endif
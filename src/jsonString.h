@@ -0,0 +1,130 @@
+#ifndef _JSONSTRING_H_
+#define _JSONSTRING_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+#include "arena.h"
+#include "jsonException.h"
+#include "stringView.h"
+
+namespace json {
+
+// storage of json string values and object keys.
+// up to kInlineCapacity chars are stored in the String itself. longer ones either
+// belong to the String (heap) or live somewhere that outlives it (an Arena, or a
+// caller's buffer), in which case the dtor does nothing.
+// copies are always inline or heap owned, so they never depend on where the
+// source lived; the heap chars are immutable and shared by the copies.
+class String final {
+public:
+    static constexpr std::size_t kInlineCapacity = 23;
+
+    String() noexcept { __bytes[kTag] = 0; }
+    // copy the chars into the String if they fit, otherwise into the arena,
+    // or onto the heap if arena is nullptr
+    explicit String(StringView str, Arena* arena = nullptr) : String() {
+        if (str.size() > UINT32_MAX) throwException(JsonException("string too long"));
+        if (str.size() <= kInlineCapacity) {
+            memcpy(__bytes, str.data(), str.size());
+            __bytes[kTag] = static_cast<char>(str.size());
+            return;
+        }
+        char* data;
+        if (arena) data = static_cast<char*>(arena->allocate(str.size(), 1));
+        else {
+            char* buf = new char[sizeof(refs_t) + str.size()];
+            new (buf) refs_t(1);
+            data = buf + sizeof(refs_t);
+        }
+        memcpy(data, str.data(), str.size());
+        setExternal(data, str.size(), arena ? kBorrowed : kHeap);
+    }
+    // refer to chars owned by someone else, without copying
+    static String view(StringView str) noexcept {
+        String ret;
+        ret.setExternal(str.data(), str.size(), kBorrowed);
+        return ret;
+    }
+
+    // heap chars are shared, borrowed ones are copied
+    String(const String& rhs) {
+        memcpy(__bytes, rhs.__bytes, sizeof(__bytes));
+        if (tag() == kHeap) refs().fetch_add(1, std::memory_order_relaxed);
+        else if (tag() == kBorrowed) String(StringView(rhs)).swap(*this);
+    }
+    String(String&& rhs) noexcept {
+        memcpy(__bytes, rhs.__bytes, sizeof(__bytes));
+        rhs.__bytes[kTag] = 0;
+    }
+    String& operator=(String rhs) noexcept {
+        swap(rhs);
+        return *this;
+    }
+    ~String() {
+        if (tag() == kHeap && refs().fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete[] (data() - sizeof(refs_t));
+    }
+
+    void swap(String& rhs) noexcept {
+        char tmp[sizeof(__bytes)];
+        memcpy(tmp, __bytes, sizeof(__bytes));
+        memcpy(__bytes, rhs.__bytes, sizeof(__bytes));
+        memcpy(rhs.__bytes, tmp, sizeof(__bytes));
+    }
+
+    const char* data() const noexcept {
+        if (tag() <= kInlineCapacity) return __bytes;
+        const char* data;
+        memcpy(&data, __bytes, sizeof(data));
+        return data;
+    }
+    std::size_t size() const noexcept {
+        if (tag() <= kInlineCapacity) return tag();
+        std::uint32_t size;
+        memcpy(&size, __bytes + sizeof(const char*), sizeof(size));
+        return size;
+    }
+    operator StringView() const noexcept { return StringView(data(), size()); }
+
+private:
+    // the last byte is the size of inline chars, or one of the tags below.
+    // otherwise the String holds the address and the size of its chars.
+    static constexpr std::size_t kTag = 23;
+    static constexpr unsigned char kHeap = 0x40;       // refcounted chars on the heap
+    static constexpr unsigned char kBorrowed = 0x80;   // chars in an arena or a caller's buffer
+
+    // heap chars are preceded by the count of the Strings sharing them
+    using refs_t = std::atomic<std::uint32_t>;
+    refs_t& refs() const noexcept {
+        return *reinterpret_cast<refs_t*>(const_cast<char*>(data()) - sizeof(refs_t));
+    }
+    unsigned char tag() const noexcept { return static_cast<unsigned char>(__bytes[kTag]); }
+    void setExternal(const char* data, std::size_t size, unsigned char tag) noexcept {
+        std::uint32_t size32 = static_cast<std::uint32_t>(size);
+        memcpy(__bytes, &data, sizeof(data));
+        memcpy(__bytes + sizeof(data), &size32, sizeof(size32));
+        __bytes[kTag] = static_cast<char>(tag);
+    }
+
+    alignas(8) char __bytes[24];
+};
+
+inline bool operator== (const String& lhs, const String& rhs) noexcept {
+    return StringView(lhs) == StringView(rhs);
+}
+inline bool operator!= (const String& lhs, const String& rhs) noexcept {
+    return !(lhs == rhs);
+}
+
+struct StringHash {
+    std::size_t operator()(const String& str) const noexcept {
+        return StringView(str).hash();
+    }
+};
+
+}   // namespace json
+
+#endif
@@ -7,7 +7,9 @@
 
 namespace json{
 
-// Jsonunique_ptr<JsonValue> __value
+// Boxed, virtual-dispatch value hierarchy.
+// Json used to hold a unique_ptr<JsonValue>; it is now a tagged union (see json.h),
+// this hierarchy is kept as the baseline of test/benchmark.cpp.
 class JsonValue{
 public:
     virtual ~JsonValue() = default;
@@ -15,33 +17,33 @@ public:
     virtual JsonType type() const = 0;   // pure virtual
 
     virtual bool toBool() const {
-        throw JsonException("not a bool");
+        throwException(JsonException("not a bool"));
     }
     virtual double toDouble() const {
-        throw JsonException("not a number");
+        throwException(JsonException("not a number"));
     }
     virtual const std::string& toString() const {
-        throw JsonException("not a string");
+        throwException(JsonException("not a string"));
     }
     virtual const Json::array_t& toArray() const {
-        throw JsonException("not an array");
+        throwException(JsonException("not an array"));
     }
     virtual const Json::object_t& toObject() const {
-        throw JsonException("not an object");
+        throwException(JsonException("not an object"));
     }
-    // array[]
+    // 重载array[]
     virtual Json& operator[](size_t) {
-        throw JsonException("not an array");
+        throwException(JsonException("not an array"));
     }
     virtual const Json& operator[](size_t) const {
-        throw JsonException("not an array");
+        throwException(JsonException("not an array"));
     }
-    // object[]
+    // 重载object[]
     virtual Json& operator[](const std::string&) {
-        throw JsonException("not an object");
+        throwException(JsonException("not an object"));
     }
     virtual const Json& operator[](const std::string&) const {
-        throw JsonException("not an object");
+        throwException(JsonException("not an object"));
     }
 
     virtual size_t size() const noexcept{ return 0; }
@@ -51,11 +53,11 @@ template <typename T, JsonType U>
 class Value : public JsonValue {
 public:
     Value(const T& val) : _val(val) {}
-    Value(T&& val) : _val(val) {}
+    Value(T&& val) : _val(std::move(val)) {}
 
     JsonType type() const final {
         return U;
-    };  // ӸֺţԶ﷨ͶˣӾͲ
+    };  // 这加个分号，自动语法就对了，不加就不对
 protected:
     T _val;
 };
@@ -94,7 +96,7 @@ public:
 class JsonArray final : public Value<Json::array_t, JsonType::tARRAY>{
 public:
     explicit JsonArray(const Json::array_t& val) : Value(val) {}
-    explicit JsonArray(Json::array_t&& val) : Value(val) {}
+    explicit JsonArray(Json::array_t&& val) : Value(std::move(val)) {}
     const Json::array_t& toArray() const override {
         return _val;
     }
@@ -117,10 +119,10 @@ public:
         return _val;
     }
     const Json& operator[](const std::string& i) const override {
-        return _val.at(i);
+        return _val.at(String::view(i));
     }
     Json& operator[](const std::string& i) override {
-        return _val.at(i);
+        return _val.at(String::view(i));
     }
     size_t size() const noexcept override{
         return _val.size();
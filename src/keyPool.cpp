@@ -0,0 +1,13 @@
+#include "keyPool.h"
+
+namespace json {
+
+String KeyPool::intern(StringView key) {
+    if (key.size() <= String::kInlineCapacity) return String(key);
+    auto it = __keys.find(String::view(key));
+    if (it != __keys.end()) return *it;
+    if (__keys.size() == __maxKeys) return String(key);
+    return *__keys.insert(String(key)).first;
+}
+
+}   // namespace json
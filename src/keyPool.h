@@ -0,0 +1,35 @@
+#ifndef _KEYPOOL_H_
+#define _KEYPOOL_H_
+
+#include <cstddef>
+#include <unordered_set>
+#include "jsonString.h"
+#include "stringView.h"
+#include "uncopyable.h"
+
+namespace json {
+
+// table of object keys. the parsers given a KeyPool store every distinct key
+// once: the keys of their results share its chars instead of allocating their
+// own, and can be compared by address with the Strings it returns.
+// keys short enough to be stored inline cost no allocation and are not stored.
+// a KeyPool may serve any number of documents, but one thread at a time.
+class KeyPool final : uncopyable {
+public:
+    // at most maxKeys distinct keys are stored, others are not shared
+    explicit KeyPool(std::size_t maxKeys = 1 << 16) : __maxKeys(maxKeys) {}
+
+    // the stored String equal to key (added if there is none), sharing its chars
+    String intern(StringView key);
+
+    std::size_t size() const noexcept { return __keys.size(); }
+    void clear() noexcept { __keys.clear(); }
+
+private:
+    std::size_t __maxKeys;
+    std::unordered_set<String, StringHash> __keys;
+};
+
+}   // namespace json
+
+#endif
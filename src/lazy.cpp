@@ -0,0 +1,189 @@
+#include "lazy.h"
+#include <cstring>
+#include "flatMap.h"
+#include "jsonException.h"
+#include "parse.h"
+#include "scan.h"
+using namespace std;
+
+namespace json {
+
+namespace {
+
+inline bool isValueStart(char ch) noexcept {
+    return ch != ',' && ch != ':' && ch != ']' && ch != '}';
+}
+
+// key between its quotes, which has no escape to decode
+inline bool isPlainKey(StringView key) noexcept {
+    const char* last = key.data() + key.size() - 1;
+    return scanString(key.data() + 1, last) == last;
+}
+
+}   // namespace
+
+LazyDocument::LazyDocument(StringView content) : __content(content), __root(0) {
+    // the Parser stops at a NUL char
+    if (const void* nul = memchr(content.data(), '\0', content.size()))
+        __content = StringView(content.data(), static_cast<const char*>(nul) - content.data());
+    const char* begin = __content.data();
+    const char* end = begin + __content.size();
+    if (!structuralIndex(begin, end, __positions)) throwException(JsonException("DOCUMENT TOO LARGE"));
+    __match.assign(__positions.size(), 0);
+    vector<uint32_t> open;
+    bool balanced = true;
+    for (uint32_t i = 0; balanced && i != __positions.size(); ++i) {
+        char ch = begin[__positions[i]];
+        if (ch == '[' || ch == '{') open.push_back(i);
+        else if (ch == ']' || ch == '}') {
+            balanced = !open.empty() && begin[__positions[open.back()]] == (ch == ']' ? '[' : '{');
+            if (balanced) {
+                __match[open.back()] = i;
+                open.pop_back();
+            }
+        }
+    }
+    if (!balanced || !open.empty()) {
+        // the parser tells where it goes wrong
+        Parser(__content).parse();
+        throwException(JsonException("UNBALANCED BRACKETS"));
+    }
+    __root = skipWhitespace(begin, end) - begin;
+}
+
+JsonType LazyValue::type() const noexcept {
+    if (__pos == __doc->__content.size()) return JsonType::tNULL;
+    switch (__doc->__content[__pos]) {
+        case '{' : return JsonType::tOBJ;
+        case '[' : return JsonType::tARRAY;
+        case '\"' : return JsonType::tSTR;
+        case 'n' : return JsonType::tNULL;
+        case 't' : case 'f' : return JsonType::tBOOL;
+        default : return JsonType::tNUM;
+    }
+}
+
+bool LazyValue::indexed() const noexcept {
+    return __first < __doc->__positions.size() && __doc->__positions[__first] == __pos;
+}
+
+size_t LazyValue::next() const noexcept {
+    if (!indexed()) return __first;
+    char ch = __doc->__content[__pos];
+    if (ch == '[' || ch == '{') return __doc->__match[__first] + 1;
+    return __first + 1;
+}
+
+LazyValue LazyValue::after(size_t sep) const noexcept {
+    const char* text = __doc->__content.data();
+    const char* end = text + __doc->__content.size();
+    size_t pos = skipWhitespace(text + __doc->__positions[sep] + 1, end) - text;
+    return LazyValue(__doc, pos, sep + 1);
+}
+
+StringView LazyValue::key(const LazyValue& name) const {
+    const char* text = __doc->__content.data();
+    const vector<uint32_t>& positions = __doc->__positions;
+    size_t colon = name.__first + 1;
+    if (!name.indexed() || text[name.__pos] != '\"' || text[positions[colon]] != ':') invalid();
+    // the key ends with the last quote before the colon
+    const char* first = text + name.__pos;
+    const char* last = text + positions[colon];
+    while (isWhitespace(last[-1])) --last;
+    if (--last == first || *last != '\"') invalid();
+    return StringView(first, last + 1 - first);
+}
+
+string LazyValue::decodedKey(StringView key) const {
+    return Parser(key).parse().toString();
+}
+
+void LazyValue::invalid() const {
+    // the parser tells where it goes wrong
+    get();
+    throwException(JsonException("INVALID VALUE"));
+}
+
+size_t LazyValue::size() const {
+    JsonType t = type();
+    if (t != JsonType::tARRAY && t != JsonType::tOBJ) return 0;
+    const char* text = __doc->__content.data();
+    const vector<uint32_t>& positions = __doc->__positions;
+    size_t close = __doc->__match[__first];
+    if (after(__first).__pos == positions[close]) return 0;
+    size_t count = 0;
+    // distinct keys, as views of the text: only keys with escapes are decoded
+    FlatMap<bool> keys;
+    for (size_t sep = __first; sep != close; ++count) {
+        LazyValue val = after(sep);
+        if (t == JsonType::tOBJ) {
+            StringView raw = key(val);
+            if (isPlainKey(raw)) keys.emplace(String::view(StringView(raw.data() + 1, raw.size() - 2)), true);
+            else keys.emplace(String(StringView(decodedKey(raw))), true);
+            val = after(val.__first + 1);
+        }
+        if (val.indexed() && !isValueStart(text[val.__pos])) invalid();
+        sep = val.next();
+        if (sep != close && text[positions[sep]] != ',') invalid();
+    }
+    // a duplicated key counts once, as in Json::size()
+    return t == JsonType::tARRAY ? count : keys.size();
+}
+
+LazyValue LazyValue::operator[](size_t i) const {
+    if (type() != JsonType::tARRAY) throwException(JsonException("not an array"));
+    const char* text = __doc->__content.data();
+    size_t close = __doc->__match[__first];
+    if (after(__first).__pos != __doc->__positions[close]) {
+        for (size_t sep = __first; sep != close; --i) {
+            LazyValue val = after(sep);
+            if (val.indexed() && !isValueStart(text[val.__pos])) invalid();
+            if (i == 0) return val;
+            sep = val.next();
+            if (sep != close && text[__doc->__positions[sep]] != ',') invalid();
+        }
+    }
+    throwException(JsonException("index out of range"));
+}
+
+LazyValue LazyValue::operator[](StringView key) const {
+    if (type() != JsonType::tOBJ) throwException(JsonException("not an object"));
+    const char* text = __doc->__content.data();
+    const vector<uint32_t>& positions = __doc->__positions;
+    size_t close = __doc->__match[__first];
+    bool found = false;
+    LazyValue result(*this);
+    if (after(__first).__pos != positions[close]) {
+        for (size_t sep = __first; sep != close;) {
+            LazyValue name = after(sep);
+            StringView raw = this->key(name);
+            LazyValue val = after(name.__first + 1);
+            if (val.indexed() && !isValueStart(text[val.__pos])) invalid();
+            bool match;
+            if (isPlainKey(raw)) match = StringView(raw.data() + 1, raw.size() - 2) == key;
+            else match = decodedKey(raw) == key;
+            if (match) {
+                found = true;
+                result = val;
+            }
+            sep = val.next();
+            if (sep != close && text[positions[sep]] != ',') invalid();
+        }
+    }
+    if (!found) throwException(JsonException("key not found"));
+    return result;
+}
+
+Json LazyValue::get() const {
+    return Parser(raw()).parse();
+}
+
+StringView LazyValue::raw() const noexcept {
+    const StringView& content = __doc->__content;
+    // the root extends to the end of the document
+    size_t next = __first ? this->next() : __doc->__positions.size();
+    size_t end = next < __doc->__positions.size() ? __doc->__positions[next] : content.size();
+    return StringView(content.data() + __pos, end - __pos);
+}
+
+}   // namespace json
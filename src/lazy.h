@@ -0,0 +1,81 @@
+#ifndef _LAZY_H_
+#define _LAZY_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "json.h"
+#include "stringView.h"
+#include "uncopyable.h"
+
+namespace json {
+
+class LazyDocument;
+
+// a value of a LazyDocument, located but not parsed.
+// navigating skips the siblings it passes over without parsing them, and
+// get() parses only this value. a value is valid as long as its document.
+class LazyValue {
+public:
+    // from the first char of the value, which is not checked further
+    JsonType type() const noexcept;
+    // elements of an array or members of an object, 0 otherwise.
+    // a key that appears more than once is counted once, like for Json
+    std::size_t size() const;
+    // Accesses a field of a JSON array, throws if it is out of range
+    LazyValue operator[](std::size_t) const;
+    // Accesses a field of a JSON object, throws if it is missing
+    // (if a key appears more than once, the last one wins, like for Json)
+    LazyValue operator[](StringView key) const;
+    // parse the value, with the errors of Json::parse
+    Json get() const;
+    // text of the value, whitespace around it included
+    StringView raw() const noexcept;
+
+private:
+    friend class LazyDocument;
+    LazyValue(const LazyDocument* doc, std::size_t pos, std::size_t first) noexcept
+        : __doc(doc), __pos(pos), __first(first) {}
+
+    // first char of the value is a structural char ('"', '[' or '{')
+    bool indexed() const noexcept;
+    // index of the structural char following the value
+    std::size_t next() const noexcept;
+    // value starting after the structural char sep
+    LazyValue after(std::size_t sep) const noexcept;
+    // key of the member starting at name, quotes included (escapes are not decoded)
+    StringView key(const LazyValue& name) const;
+    // key with escapes, decoded
+    std::string decodedKey(StringView key) const;
+    [[noreturn]] void invalid() const;
+
+    const LazyDocument* __doc;
+    std::size_t __pos;      // offset of the first char of the value
+    std::size_t __first;    // index of the first structural char at or after __pos
+};
+
+// on-demand access to a json text: only its structural chars are indexed up
+// front, values are parsed when they are asked for with LazyValue::get().
+// brackets must balance (the error of Json::parse is thrown otherwise), other
+// errors are only reported by the parts of the document that are accessed.
+// content must outlive the document, a NUL char ends it like for Json::parse.
+class LazyDocument final : uncopyable {
+public:
+    explicit LazyDocument(StringView content);
+
+    LazyValue root() const noexcept { return LazyValue(this, __root, 0); }
+    StringView content() const noexcept { return __content; }
+
+private:
+    friend class LazyValue;
+
+    StringView __content;
+    std::size_t __root;     // offset of the root value
+    std::vector<std::uint32_t> __positions;     // see structuralIndex()
+    // for '[' and '{': index of the matching bracket in __positions
+    std::vector<std::uint32_t> __match;
+};
+
+}   // namespace json
+
+#endif
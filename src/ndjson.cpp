@@ -0,0 +1,197 @@
+#include "ndjson.h"
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "jsonException.h"
+#include "parallel.h"
+#include "scan.h"
+using namespace std;
+
+namespace json {
+
+namespace {
+
+constexpr size_t kBatchSize = 1 << 16;
+// batches parsed ahead of the ordered delivery, per thread
+constexpr size_t kBatchesAhead = 4;
+
+struct Batch {
+    const char* begin;
+    const char* end;
+    size_t firstLine;
+    vector<NdjsonRecord> records;   // parsed, waiting for the ordered delivery
+    bool ready;
+};
+
+// cut after the first line end following every kBatchSize bytes
+vector<Batch> splitBatches(StringView content) {
+    vector<Batch> batches;
+    const char* p = content.data();
+    const char* end = p + content.size();
+    while (p != end) {
+        const char* next = end;
+        if (static_cast<size_t>(end - p) > kBatchSize) {
+            const void* eol = memchr(p + kBatchSize, '\n', end - p - kBatchSize);
+            if (eol) next = static_cast<const char*>(eol) + 1;
+        }
+        batches.push_back({p, next, 0, {}, false});
+        p = next;
+    }
+    return batches;
+}
+
+size_t countLines(const char* p, const char* end) noexcept {
+    size_t lines = 0;
+    while (const void* eol = memchr(p, '\n', end - p)) {
+        p = static_cast<const char*>(eol) + 1;
+        ++lines;
+    }
+    return lines;
+}
+
+// returns the line number following the batch
+template <typename F>
+size_t parseLines(const Batch& batch, F&& deliver) {
+    size_t line = batch.firstLine;
+    for (const char* p = batch.begin; p != batch.end; ++line) {
+        const char* eol = static_cast<const char*>(memchr(p, '\n', batch.end - p));
+        const char* lineEnd = eol ? eol : batch.end;
+        if (skipWhitespace(p, lineEnd) != lineEnd) {
+            NdjsonRecord record{line, Json(nullptr), string()};
+            record.value = Json::parse(StringView(p, lineEnd - p), record.errmsg);
+            deliver(record);
+        }
+        p = eol ? eol + 1 : batch.end;
+    }
+    return line;
+}
+
+// the threads parse batches in turn, the calling thread delivers them in order
+void readOrdered(unsigned threads, vector<Batch>& batches, const NdjsonReader::callback_t& callback) {
+    mutex m;
+    condition_variable cv;
+    size_t next = 0;        // next batch to parse
+    size_t delivered = 0;   // batches already delivered
+    bool stop = false;
+    exception_ptr error;
+    auto work = [&] {
+        for (;;) {
+            size_t i;
+            {
+                unique_lock<mutex> lock(m);
+                cv.wait(lock, [&] { return stop || next == batches.size() || next < delivered + threads * kBatchesAhead; });
+                if (stop || next == batches.size()) return;
+                i = next++;
+            }
+            JSON_TRY {
+                parseLines(batches[i], [&batches, i](NdjsonRecord& record) { batches[i].records.push_back(std::move(record)); });
+            } JSON_CATCH(...) {
+                lock_guard<mutex> lock(m);
+                if (!error) error = current_exception();
+                stop = true;
+                cv.notify_all();
+                return;
+            }
+            lock_guard<mutex> lock(m);
+            batches[i].ready = true;
+            cv.notify_all();
+        }
+    };
+    vector<thread> workers;
+    workers.reserve(threads);
+    JSON_TRY {
+        for (unsigned t = 0; t < threads; ++t) workers.emplace_back(work);
+    } JSON_CATCH(...) {
+        // the threads already running parse every batch, if there are any
+        if (workers.empty()) {
+            error = current_exception();
+            stop = true;
+        }
+    }
+    JSON_TRY {
+        for (Batch& batch : batches) {
+            {
+                unique_lock<mutex> lock(m);
+                cv.wait(lock, [&] { return stop || batch.ready; });
+                if (stop) break;
+            }
+            for (NdjsonRecord& record : batch.records) callback(record);
+            vector<NdjsonRecord>().swap(batch.records);
+            lock_guard<mutex> lock(m);
+            ++delivered;
+            cv.notify_all();
+        }
+    } JSON_CATCH(...) {
+        lock_guard<mutex> lock(m);
+        if (!error) error = current_exception();
+        stop = true;
+        cv.notify_all();
+    }
+    for (thread& worker : workers) worker.join();
+    if (error) rethrow_exception(error);
+}
+
+}   // namespace
+
+NdjsonReader::NdjsonReader(unsigned threads) : __threads(threads) {
+    if (!__threads) __threads = max(1u, thread::hardware_concurrency());
+}
+
+void NdjsonReader::read(StringView content, const callback_t& callback, bool ordered) const {
+    vector<Batch> batches = splitBatches(content);
+    unsigned threads = static_cast<unsigned>(min<size_t>(__threads, batches.size()));
+    if (threads <= 1) {
+        size_t line = 0;
+        for (Batch& batch : batches) {
+            batch.firstLine = line;
+            line = parseLines(batch, callback);
+        }
+        return;
+    }
+    // the first line of each batch, from the line ends of the previous ones
+    vector<size_t> lines(batches.size());
+    forEachParallel(threads, batches.size(), [&](size_t i) { lines[i] = countLines(batches[i].begin, batches[i].end); });
+    for (size_t i = 1; i < batches.size(); ++i) batches[i].firstLine = batches[i - 1].firstLine + lines[i - 1];
+
+    if (ordered) readOrdered(threads, batches, callback);
+    else forEachParallel(threads, batches.size(), [&](size_t i) { parseLines(batches[i], callback); });
+}
+
+void NdjsonReader::readFile(const string& path, const callback_t& callback, bool ordered) const {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throwException(JsonException("cannot open " + path + ": " + strerror(errno)));
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int err = errno;
+        close(fd);
+        throwException(JsonException("cannot stat " + path + ": " + strerror(err)));
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        close(fd);
+        return;
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (data == MAP_FAILED) throwException(JsonException("cannot map " + path + ": " + strerror(err)));
+    madvise(data, size, MADV_SEQUENTIAL);
+    // unmapped on the way out, exceptions included
+    struct Unmap {
+        void* data;
+        size_t size;
+        ~Unmap() { munmap(data, size); }
+    } unmap{data, size};
+    read(StringView(static_cast<const char*>(data), size), callback, ordered);
+}
+
+}   // namespace json
@@ -0,0 +1,47 @@
+#ifndef _NDJSON_H_
+#define _NDJSON_H_
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "json.h"
+#include "stringView.h"
+#include "uncopyable.h"
+
+namespace json {
+
+// a line of newline-delimited json (NDJSON / JSON Lines)
+struct NdjsonRecord {
+    std::size_t line;       // 0-based line number in the input
+    Json value;             // null if the line is not valid json
+    std::string errmsg;     // error of Json::parse, empty if the line is valid
+};
+
+// parses newline-delimited json on several threads: the input is cut into
+// batches of lines, which the threads take in turn. blank lines are skipped.
+class NdjsonReader final : uncopyable {
+public:
+    using callback_t = std::function<void(NdjsonRecord& record)>;
+
+    // threads = 0: one per hardware thread
+    explicit NdjsonReader(unsigned threads = 0);
+
+    // ordered: callback is called on the calling thread, in the order of the lines,
+    // at most a few batches per thread are kept waiting for it.
+    // unordered: callback is called by the threads as soon as a record is parsed,
+    // possibly concurrently, record.line tells where the record comes from.
+    // an exception thrown by callback stops the reading and is rethrown.
+    void read(StringView content, const callback_t& callback, bool ordered = true) const;
+    // same for the content of a file, which is mapped in memory.
+    // throws JsonException if it cannot be read.
+    void readFile(const std::string& path, const callback_t& callback, bool ordered = true) const;
+
+    unsigned threads() const noexcept { return __threads; }
+
+private:
+    unsigned __threads;
+};
+
+}   // namespace json
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef _NUMBER_H_
+#define _NUMBER_H_
+
+#include <cstdint>
+#include "stringView.h"
+
+namespace json {
+
+// number conversions used by the Parser, independent of the C locale.
+
+// w * 10^q correctly rounded to the nearest double (ties to even).
+// overflow gives +infinity, underflow gives 0.
+double decimalToDouble(std::uint64_t w, std::int64_t q) noexcept;
+
+// slow path for numbers with more significant digits than fit in 64 bits,
+// str must be a valid json number.
+double parseDouble(StringView str);
+
+// decimal text of an integer, written at buf (20 chars at most, not
+// NUL-terminated). returns the end of the text.
+char* formatInteger(std::int64_t val, char* buf) noexcept;
+char* formatInteger(std::uint64_t val, char* buf) noexcept;
+
+// shortest decimal text that reads back as val (25 chars at most, not
+// NUL-terminated), like 0.1, 1e+21 or 5e-324. returns the end of the text.
+char* formatDouble(double val, char* buf) noexcept;
+
+}   // namespace json
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "jsonException.h"
+
+namespace json {
+
+// calls f(i) for i in [0, n) on threads threads (the calling one included),
+// each thread taking the next i in turn. the first exception thrown by f
+// stops the other calls and is rethrown once all threads are done.
+// if a thread cannot be started, the ones already running (at least the
+// calling one) share the work.
+template <typename F>
+void forEachParallel(unsigned threads, std::size_t n, F&& f) {
+    std::atomic<std::size_t> next(0);
+    std::mutex m;
+    std::exception_ptr error;
+    auto work = [&] {
+        JSON_TRY {
+            for (std::size_t i; (i = next++) < n;) f(i);
+        } JSON_CATCH(...) {
+            std::lock_guard<std::mutex> lock(m);
+            if (!error) error = std::current_exception();
+            next = n;
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads > 1 ? threads - 1 : 0);     // may throw before any thread runs
+    JSON_TRY {
+        for (unsigned t = 1; t < threads; ++t) workers.emplace_back(work);
+    } JSON_CATCH(...) {}
+    work();
+    for (std::thread& worker : workers) worker.join();
+    if (error) std::rethrow_exception(error);
+}
+
+}   // namespace json
+
+#endif
@@ -1,8 +1,9 @@
 #include "parse.h"
+#include "number.h"
+#include "scan.h"
 #include <cassert>
-#include <cmath>        //HUGE_VAL
-#include <cstdlib>      //strtod
-#include <cstring>      //strncmp
+#include <cmath>        //isinf
+#include <cstring>      //memcmp
 #include <stdexcept>    //runtime_error
 
 using namespace std;
@@ -11,184 +12,248 @@ namespace json{
 constexpr bool is1to9(char ch) { return ch >= '1' && ch <= '9'; }
 constexpr bool is0to9(char ch) { return ch >= '0' && ch <= '9'; }
 
+Json& DomBuilder::add(Json&& val) {
+    if (__stack.empty()) return __root = std::move(val);
+    Json& top = *__stack.back();
+    if (top.__type == JsonType::tARRAY) {
+        top.__arr->push_back(std::move(val));
+        return top.__arr->back();
+    }
+    // the last of duplicated keys wins
+    Json& slot = top.__obj->emplace(std::move(__key), Json(nullptr)).first->second;
+    return slot = std::move(val);
+}
+
+void DomBuilder::onStartObject() {
+    __stack.push_back(&add(Json(JsonType::tOBJ, __arena)));
+}
+
+void DomBuilder::onStartArray() {
+    __stack.push_back(&add(Json(JsonType::tARRAY, __arena)));
+}
+
 Json Parser::parse() {
-    parseWhitespace();
-    Json json = parseValue();
-    parseWhitespace();
-    if (*__cur) error("ROOT NOT SINGULAR");
-    return json;
+    DomBuilder builder(__arena, __insitu != nullptr, __keys);
+    parse(builder);
+    return std::move(builder.root());
 }
 
-Json Parser::parseValue(){
-    switch (*__cur){
-        case 'n': return parseLiteral("null");
-        case 't': return parseLiteral("true");
-        case 'f': return parseLiteral("false");
-        case '\"': return parseString();    //ֱӵparseRawString()
-        case '[': return parseArray();
-        case '{': return parseObject();
-        case '\0': error("EXPECT VALUE");
-        default: return parseNumber();
-    }
+Json Parser::parse(ParseError& error) {
+    DomBuilder builder(__arena, __insitu != nullptr, __keys);
+    if (!parse(builder, error)) return Json(nullptr);
+    return std::move(builder.root());
 }
 
-Json Parser::parseLiteral(const string& literal) {
-    if (strncmp(__cur, literal.c_str(), literal.size())) error("INVALID VALUE");
+bool Parser::validate(ParseError& error) noexcept {
+    struct Ignore final : SaxHandler<Ignore> {} ignore;
+    char* insitu = __insitu;
+    __insitu = nullptr;
+    __validate = true;
+    bool ok = parseDocument(ignore);
+    __validate = false;
+    __insitu = insitu;
+    error = __error;
+    return ok;
+}
+
+bool Parser::parseLiteral(StringView literal) {
+    if (static_cast<size_t>(__end - __cur) < literal.size() || memcmp(__cur, literal.data(), literal.size())) {
+        // at the first char that differs
+        const char* p = __cur;
+        while (p != __end && *p == literal[p - __cur]) ++p;
+        return fail(ParseError::INVALID_VALUE, p);
+    }
     __cur += literal.size();
     __start = __cur;
-    switch (literal[0]) {
-        case 't': return Json(true);
-        case 'f': return Json(false);
-        default: return Json(nullptr);
-    }
+    return true;
 }
-Json Parser::parseNumber(){
-    if (*__cur == '-') ++__cur;
+
+bool Parser::parseNumber(Json& num){
+    // the value is computed while the grammar is checked:
+    // up to 19 significant digits go to w, the others only move the decimal exponent q
+    uint64_t w = 0;
+    int64_t q = 0;
+    int digits = 0;
+    bool truncated = false;
+    bool negative = peek() == '-';
+    if (negative) ++__cur;
     //int
-    if (*__cur == '0') ++__cur;
+    if (peek() == '0') ++__cur;
     else {
-        if (!is1to9(*__cur)) error("INVALID VALUE");
-        while (is0to9(*++__cur));
+        if (!is1to9(peek())) return fail(ParseError::INVALID_VALUE);
+        char ch = peek();
+        do {
+            if (digits < 19) {
+                w = w * 10 + (ch - '0');
+                ++digits;
+            } else {
+                ++q;
+                truncated |= ch != '0';
+            }
+        } while (is0to9(ch = next()));
     }
+    bool integer = true;
     //frac
-    if (*__cur == '.') {
-        if (!is0to9(*++__cur)) error("INVALID VALUE");
-        while (is0to9(*++__cur));
+    if (peek() == '.') {
+        integer = false;
+        char ch = next();
+        if (!is0to9(ch)) return fail(ParseError::INVALID_VALUE);
+        do {
+            if (digits < 19) {
+                w = w * 10 + (ch - '0');
+                if (w) ++digits;    // leading zeros are not significant
+                --q;
+            } else {
+                truncated |= ch != '0';
+            }
+        } while (is0to9(ch = next()));
     }
     //exp
-    if (toupper(*__cur) == 'E'){
+    if (peek() == 'e' || peek() == 'E'){
+        integer = false;
         ++__cur;
-        if (*__cur == '-' || *__cur == '+') ++__cur;
-        if (!is0to9(*__cur)) error("INVALID VALUE");
-        while (is0to9(*++__cur));
+        bool expNegative = peek() == '-';
+        if (peek() == '-' || peek() == '+') ++__cur;
+        char ch = peek();
+        if (!is0to9(ch)) return fail(ParseError::INVALID_VALUE);
+        int64_t exp = 0;
+        do {
+            if (exp < 100000) exp = exp * 10 + (ch - '0');   // saturate, the result is 0 or inf anyway
+        } while (is0to9(ch = next()));
+        q += expNegative ? -exp : exp;
     }
-    //
-    double val = strtod(__start, nullptr);
-    if (fabs(val) == HUGE_VAL) error("NUMBER TOO BIG");
+    if (integer) {
+        // a 20th digit was left out of w, it still fits if w * 10 + d does not overflow
+        uint64_t d = __cur[-1] - '0';
+        if (q == 1 && w <= (UINT64_MAX - d) / 10) {
+            w = w * 10 + d;
+            q = 0;
+        }
+        if (q == 0 && (!negative || w <= (1ULL << 63))) {
+            __start = __cur;
+            if (!negative) num = Json(static_cast<unsigned long long>(w));
+            else if (w == 0) num = Json(-0.0);
+            else num = Json(static_cast<long long>(w == (1ULL << 63) ? INT64_MIN : -static_cast<int64_t>(w)));
+            return true;
+        }
+        // out of the 64-bit range, fall back to double
+    }
+    double val = decimalToDouble(w, q);
+    // dropped digits: w <= exact < w + 1, if both ends round the same way that is the answer
+    if (truncated) {
+        double upper = decimalToDouble(w + 1, q);
+        // parseDouble() allocates, validation only needs it when one end overflows
+        if (upper != val && (!__validate || std::isinf(upper) != std::isinf(val)))
+            val = parseDouble(StringView(__start + negative, __cur - __start - negative));
+    }
+    if (std::isinf(val)) return fail(ParseError::NUMBER_TOO_BIG, __start);
     __start = __cur;
-    return Json(val);
+    num = Json(negative ? -val : val);
+    return true;
 }
-string Parser::parseRawString() {
-    string str;
+
+bool Parser::parseRawString(StringView& str) {
+    const char* begin = ++__cur;  // skip '"'
+    const char* run = begin;      // first char not yet appended
+    __buf.clear();
+    if (__insitu) __dst = __insitu + (begin - __insitu);   // decode over the raw chars
     while(1){
-        switch (*++__cur){
-            case '\"' : __start = ++__cur; return str;
-            case '\0' : error("MISS QUOTATION MARK");
-            default :{
-                if (static_cast<unsigned char>(*__cur) < 0x20) error("INVALID STRING CHAR");
-                str.push_back(*__cur);
-                break;
+        // skip plain chars in bulk, stop at '"', '\\', a control char or the end
+        __cur = scanString(__cur, __end);
+        if (__validate) {
+            // stop chars are ascii, so a sequence they cut short is invalid anyway
+            const char* bad = validateUTF8(run, __cur);
+            if (bad != __cur) return fail(ParseError::INVALID_UTF8, bad);
+        }
+        char ch = peek();
+        append(run, __cur - run);
+        switch (ch){
+            case '\"' : {
+                __start = ++__cur;
+                str = __insitu ? StringView(begin, __dst - begin) : StringView(__buf);
+                return true;
             }
+            case '\0' : return fail(ParseError::MISS_QUOTATION_MARK);
             case '\\' :
-                switch (*++__cur){
-                    case '\"' : str.push_back('\"'); break;
-                    case '\\': str.push_back('\\'); break;
-                    case '/': str.push_back('/'); break;
-                    case 'b': str.push_back('\b'); break;
-                    case 'f': str.push_back('\f'); break;
-                    case 'n': str.push_back('\n'); break;
-                    case 't': str.push_back('\t'); break;
-                    case 'r': str.push_back('\r'); break;
+                switch (next()){
+                    case '\"' : append("\"", 1); break;
+                    case '\\': append("\\", 1); break;
+                    case '/': append("/", 1); break;
+                    case 'b': append("\b", 1); break;
+                    case 'f': append("\f", 1); break;
+                    case 'n': append("\n", 1); break;
+                    case 't': append("\t", 1); break;
+                    case 'r': append("\r", 1); break;
                     case 'u': {
-                        unsigned u1 = parse4hex();
+                        unsigned u1, u2;
+                        if (!parse4hex(u1)) return false;
                         if (u1 >= 0xd800 && u1 <= 0xdbff) { // high surrogate
-                            if (*++__cur != '\\') error("INVALID UNICODE SURROGATE");
-                            if (*++__cur != 'u') error("INVALID UNICODE SURROGATE");
-                            unsigned u2 = parse4hex();  // low surrogate
-                            if (u2 < 0xdc00 || u2 > 0xdfff) error("INVALID UNICODE SURROGATE");
+                            if (next() != '\\') return fail(ParseError::INVALID_UNICODE_SURROGATE);
+                            if (next() != 'u') return fail(ParseError::INVALID_UNICODE_SURROGATE);
+                            if (!parse4hex(u2)) return false;   // low surrogate
+                            if (u2 < 0xdc00 || u2 > 0xdfff) return fail(ParseError::INVALID_UNICODE_SURROGATE);
                             u1 = (((u1 - 0xd800) << 10) | (u2 - 0xdc00)) + 0x10000;
                         }
-                        str += encodeUTF8(u1);
+                        char utf8[4];
+                        append(utf8, encodeUTF8(u1, utf8));
                     } break;
-                    default : error("INVALID STRING ESCAPE");
+                    default : return fail(ParseError::INVALID_STRING_ESCAPE);
                 }
+                run = ++__cur;
                 break;
+            default : return fail(ParseError::INVALID_STRING_CHAR);
         }
     }
 }
 
-unsigned Parser::parse4hex(){
-    unsigned u = 0;
+bool Parser::parse4hex(unsigned& u){
+    u = 0;
     for (int i = 0; i != 4; ++i){
         // now *__cur = "uXXXX...." ...
-        unsigned ch = static_cast<unsigned>(toupper(*++__cur));
+        unsigned ch = static_cast<unsigned>(toupper(next()));
         u <<= 4;
         if (ch >= '0' && ch <= '9') u |= (ch - '0');
         else if (ch >= 'A' && ch <= 'F') u |= ch - 'A' + 10;
-        else error("INVALID UNICODE HEX");
+        else return fail(ParseError::INVALID_UNICODE_HEX);
     }
-    return u;
+    return true;
 }
 
-string Parser::encodeUTF8(unsigned u) noexcept {
-    string utf8;
-    if (u <= 0x7F) // 0111,1111
-        utf8.push_back(static_cast<char>(u & 0xff));
-    else if (u <= 0x7FF){
-        utf8.push_back(static_cast<char>(0xc0 | ((u >> 6) & 0xff)));
-        utf8.push_back(static_cast<char>(0x80 | (u & 0x3f)));
+size_t encodeUTF8(unsigned u, char* utf8) noexcept {
+    if (u <= 0x7F) { // 0111,1111
+        utf8[0] = static_cast<char>(u & 0xff);
+        return 1;
+    } else if (u <= 0x7FF){
+        utf8[0] = static_cast<char>(0xc0 | ((u >> 6) & 0xff));
+        utf8[1] = static_cast<char>(0x80 | (u & 0x3f));
+        return 2;
     } else if (u <= 0xFFFF) {
-        utf8.push_back(static_cast<char>(0xe0 | ((u >> 12) & 0xff)));
-        utf8.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3f)));
-        utf8.push_back(static_cast<char>(0x80 | (u & 0x3f)));
+        utf8[0] = static_cast<char>(0xe0 | ((u >> 12) & 0xff));
+        utf8[1] = static_cast<char>(0x80 | ((u >> 6) & 0x3f));
+        utf8[2] = static_cast<char>(0x80 | (u & 0x3f));
+        return 3;
     } else {
         assert(u <= 0x10FFFF);
-        utf8.push_back(static_cast<char>(0xf0 | ((u >> 18) & 0xff)));
-        utf8.push_back(static_cast<char>(0x80 | ((u >> 12) & 0x3f)));
-        utf8.push_back(static_cast<char>(0x80 | ((u >> 6) & 0x3f)));
-        utf8.push_back(static_cast<char>(0x80 | (u & 0x3f)));
-    }
-    return utf8;
-}
-
-Json Parser::parseArray(){
-    Json::array_t arr;
-    ++__cur; // skip '['
-    parseWhitespace();
-    if (*__cur == ']') {
-        __start = ++__cur;
-        return Json(arr);
-    }
-    while (1) {
-        parseWhitespace();
-        arr.push_back(parseValue());
-        parseWhitespace();
-        if (*__cur == ',') ++__cur;
-        else if (*__cur == ']'){
-            __start = ++__cur;
-            return Json(arr);
-        }else error("MISS COMMA OR SQUARE BRACKET");
-    }
-}
-
-Json Parser::parseObject(){
-    Json::object_t obj;
-    ++__cur;
-    parseWhitespace();
-    if (*__cur == '}') {
-        __start = ++__cur;
-        return Json(obj);
-    }
-    while (1) {
-        parseWhitespace();
-        if (*__cur != '"') error("MISS KEY");
-        string key = parseRawString();
-        parseWhitespace();
-        if (*__cur++ != ':') error("MISS COLON");
-        parseWhitespace();
-        Json val = parseValue();
-        obj.insert({key, val});
-        parseWhitespace();
-        if (*__cur == ',') ++__cur;
-        else if (*__cur == '}'){
-            __start = ++__cur;
-            return Json(obj);
-        }else error("MISS COMMA OR CURLY BRACKET");
+        utf8[0] = static_cast<char>(0xf0 | ((u >> 18) & 0xff));
+        utf8[1] = static_cast<char>(0x80 | ((u >> 12) & 0x3f));
+        utf8[2] = static_cast<char>(0x80 | ((u >> 6) & 0x3f));
+        utf8[3] = static_cast<char>(0x80 | (u & 0x3f));
+        return 4;
     }
 }
 
 void Parser::parseWhitespace() noexcept {
-    while (*__cur == ' ' || *__cur == '\r' || *__cur == '\t' || *__cur == '\n') ++__cur;
+    // gaps are mostly empty or one char in minified text, only longer
+    // runs (indentation) are worth a call to the vectorized skipper.
+    const char* first = __cur;
+    if (isWhitespace(peek()) && isWhitespace(next())) __cur = skipWhitespace(__cur, __end);
+    // whitespace is the only place for a raw new line
+    while (first != __cur) {
+        const void* nl = memchr(first, '\n', __cur - first);
+        if (!nl) break;
+        ++__line;
+        __lineStart = first = static_cast<const char*>(nl) + 1;
+    }
     __start = __cur;
 }
 }   //namespace json
\ No newline at end of file
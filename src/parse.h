@@ -1,38 +1,293 @@
 #ifndef _PARSE_H_
 #define _PARSE_H_
 
+#include <algorithm>
+#include <cstdint>
 #include "json.h"
 #include "jsonException.h"
+#include "keyPool.h"
+#include "parseError.h"
 #include "uncopyable.h"
 
 namespace json {
 
+// events of Parser::parse(handler). handlers derive from SaxHandler<Handler>
+// and hide the events they are interested in, the others are ignored.
+// integers are reported as doubles unless their events are hidden too.
+// StringView arguments are only valid during the call.
+template <typename Derived>
+class SaxHandler {
+public:
+    void onNull() {}
+    void onBool(bool) {}
+    void onDouble(double) {}
+    void onInt64(std::int64_t val) { derived().onDouble(static_cast<double>(val)); }
+    void onUint64(std::uint64_t val) { derived().onDouble(static_cast<double>(val)); }
+    void onString(StringView) {}
+    void onStartObject() {}
+    void onKey(StringView) {}
+    void onEndObject(std::size_t /* memberCount */) {}
+    void onStartArray() {}
+    void onEndArray(std::size_t /* elementCount */) {}
+
+private:
+    Derived& derived() noexcept { return static_cast<Derived&>(*this); }
+};
+
+// builds a Json from the events, each value directly in its container.
+// the result of Parser::parse(), also usable with the other event sources.
+class DomBuilder final : public SaxHandler<DomBuilder> {
+public:
+    // if arena is not nullptr, strings and containers are allocated from it.
+    // if views is true the strings of the events outlive the result,
+    // string values and keys then refer to them instead of copying.
+    // if keys is not nullptr, keys are taken from it (see KeyPool).
+    explicit DomBuilder(Arena* arena = nullptr, bool views = false, KeyPool* keys = nullptr) noexcept
+        : __arena(arena), __views(views), __keys(keys), __root(nullptr) {}
+
+    void onNull() { add(Json(nullptr)); }
+    void onBool(bool val) { add(Json(val)); }
+    void onDouble(double val) { add(Json(val)); }
+    void onInt64(std::int64_t val) { add(Json(static_cast<long long>(val))); }
+    void onUint64(std::uint64_t val) { add(Json(static_cast<unsigned long long>(val))); }
+    void onString(StringView str) { add(Json(makeString(str))); }
+    void onStartObject();
+    void onKey(StringView str) { __key = __keys ? __keys->intern(str) : makeString(str); }
+    void onEndObject(std::size_t) { __stack.pop_back(); }
+    void onStartArray();
+    void onEndArray(std::size_t) { __stack.pop_back(); }
+
+    Json& root() noexcept { return __root; }
+
+private:
+    String makeString(StringView str) {
+        return __views ? String::view(str) : String(str, __arena);
+    }
+    // a container is not added to while one of its elements is open,
+    // so the pointers of __stack stay valid
+    Json& add(Json&& val);
+
+    Arena* __arena;
+    bool __views;
+    KeyPool* __keys;
+    Json __root;
+    String __key;       // key of the next member
+    std::vector<Json*> __stack;     // open containers
+};
+
+// utf-8 encoding of code point u (at most 0x10FFFF) into utf8, returns its length
+std::size_t encodeUTF8(unsigned u, char* utf8) noexcept;
+
 class Parser final : uncopyable {
-public: 
-    Parser(const std::string& content) noexcept : __start(content.c_str()), __cur(content.c_str()) {}
+public:
+    // content does not need to be NUL-terminated, a NUL char ends it like the end of the view.
+    // if arena is not nullptr, every string and container of the result is allocated from it
+    Parser(StringView content, Arena* arena = nullptr) noexcept
+        : __begin(content.data()), __start(content.data()), __cur(content.data()), __end(content.data() + content.size()),
+          __lineStart(content.data()), __arena(arena), __keys(nullptr), __insitu(nullptr), __dst(nullptr) {}
+    // in-situ mode: escapes are decoded in place in buffer and string values/keys
+    // of the result are views into it, so buffer must outlive the result.
+    Parser(char* buffer, std::size_t size, Arena* arena = nullptr) noexcept
+        : Parser(StringView(buffer, size), arena) { __insitu = buffer; }
+    // object keys of the results of parse() are taken from keys (see KeyPool)
+    void setKeyPool(KeyPool* keys) noexcept { __keys = keys; }
+    // throws JsonException if the content is not valid json
     Json parse();
+    // the same without exceptions: null and the error in error if the content
+    // is not valid (error is OK otherwise)
+    Json parse(ParseError& error);
+    // SAX: the same grammar and errors as parse(), but the content is reported
+    // to handler as events instead of building a Json. in in-situ mode
+    // the StringViews of the events point into the buffer.
+    template <typename Handler>
+    void parse(Handler& handler);
+    // the same without exceptions: false and the error in error if the content
+    // is not valid, the events stop at the error
+    template <typename Handler>
+    bool parse(Handler& handler, ParseError& error);
+    // only checks that the content is valid json (RFC 8259), with the errors
+    // of parse(), and also that its strings are valid UTF-8 (INVALID_UTF8):
+    // nothing is built or allocated, nor written in in-situ mode.
+    bool validate(ParseError& error) noexcept;
+    // what made the last parse() fail, if it did
+    const ParseError& error() const noexcept { return __error; }
 private:
-    Json parseValue();
-    Json parseLiteral(const std::string& literal);
-    Json parseNumber();
-    std::string parseRawString();
-    Json parseString() {
-        return Json(parseRawString());
-    };
-    unsigned parse4hex();
-    std::string encodeUTF8(unsigned u) noexcept;
-    Json parseArray();
-    Json parseObject();
+    // each of them returns false at the first error, which is in __error
+    template <typename Handler>
+    bool parseDocument(Handler& handler);
+    template <typename Handler>
+    bool parseValue(Handler& handler);
+    bool parseLiteral(StringView literal);
+    template <typename Handler>
+    bool parseNumber(Handler& handler);
+    // the number at __cur (numbers never allocate)
+    bool parseNumber(Json& num);
+    // str refers to __buf (or to the buffer in in-situ mode), valid until the next call
+    bool parseRawString(StringView& str);
+    bool parse4hex(unsigned& u);
+    template <typename Handler>
+    bool parseArray(Handler& handler);
+    template <typename Handler>
+    bool parseObject(Handler& handler);
     void parseWhitespace() noexcept;
 
-    [[noreturn]] void error(const std::string& msg) const {
-        throw JsonException(msg + ":" + __start);
+    // current char, '\0' at the end of the content
+    char peek() const noexcept { return __cur != __end ? *__cur : '\0'; }
+    // advance, then peek(). only called when peek() != '\0'
+    char next() noexcept { ++__cur; return peek(); }
+    // append decoded chars of the current string
+    void append(const char* str, std::size_t n) {
+        if (__insitu) {
+            if (__dst != str) memmove(__dst, str, n);
+            __dst += n;
+        } else if (!__validate) __buf.append(str, n);
+    }
+
+    // error at pos (the current char by default), returns false.
+    // the text before pos is not read again: in-situ mode has rewritten it
+    bool fail(ParseError::Code code, const char* pos) noexcept {
+        __error.setAt(code, pos, __end, pos - __begin, __line, pos - __lineStart + 1);
+        return false;
     }
+    bool fail(ParseError::Code code) noexcept { return fail(code, __cur); }
 
+    const char* __begin;
     const char* __start;
     const char* __cur;
+    const char* __end;
+    // line of __cur and its first char, counted by parseWhitespace()
+    std::size_t __line = 1;
+    const char* __lineStart;
+    Arena* __arena;
+    KeyPool* __keys;
+    char* __insitu;     // mutable buffer in in-situ mode, nullptr otherwise
+    char* __dst;        // in-situ write position of the current string
+    std::string __buf;  // decoded chars of the current string/number, reused between values
+    bool __validate = false;    // in validate(): strings are checked, not decoded
+    ParseError __error;
 };
-    
+
+template <typename Handler>
+void Parser::parse(Handler& handler) {
+    // the message only holds a bounded context, not the rest of the input
+    if (!parseDocument(handler)) throwException(JsonException(__error.str()));
+}
+
+template <typename Handler>
+bool Parser::parse(Handler& handler, ParseError& error) {
+    bool ok = parseDocument(handler);
+    error = __error;
+    return ok;
+}
+
+template <typename Handler>
+bool Parser::parseDocument(Handler& handler) {
+    __error = ParseError();
+    parseWhitespace();
+    if (!parseValue(handler)) return false;
+    parseWhitespace();
+    if (peek()) return fail(ParseError::ROOT_NOT_SINGULAR);
+    return true;
+}
+
+template <typename Handler>
+bool Parser::parseValue(Handler& handler) {
+    switch (peek()){
+        case 'n':
+            if (!parseLiteral("null")) return false;
+            handler.onNull();
+            return true;
+        case 't':
+            if (!parseLiteral("true")) return false;
+            handler.onBool(true);
+            return true;
+        case 'f':
+            if (!parseLiteral("false")) return false;
+            handler.onBool(false);
+            return true;
+        case '\"': {
+            StringView str;
+            if (!parseRawString(str)) return false;
+            handler.onString(str);
+            return true;
+        }
+        case '[': return parseArray(handler);
+        case '{': return parseObject(handler);
+        case '\0': return fail(ParseError::EXPECT_VALUE);
+        default: return parseNumber(handler);
+    }
+}
+
+template <typename Handler>
+bool Parser::parseNumber(Handler& handler) {
+    Json num(nullptr);
+    if (!parseNumber(num)) return false;
+    switch (num.__numType){
+        case Json::nINT64: handler.onInt64(num.__int); break;
+        case Json::nUINT64: handler.onUint64(num.__uint); break;
+        default: handler.onDouble(num.__num);
+    }
+    return true;
+}
+
+template <typename Handler>
+bool Parser::parseArray(Handler& handler) {
+    handler.onStartArray();
+    ++__cur; // skip '['
+    parseWhitespace();
+    std::size_t count = 0;
+    if (peek() == ']') {
+        __start = ++__cur;
+        handler.onEndArray(count);
+        return true;
+    }
+    while (1) {
+        parseWhitespace();
+        if (!parseValue(handler)) return false;
+        ++count;
+        parseWhitespace();
+        if (peek() == ',') ++__cur;
+        else if (peek() == ']'){
+            __start = ++__cur;
+            handler.onEndArray(count);
+            return true;
+        }else return fail(ParseError::MISS_COMMA_OR_SQUARE_BRACKET);
+    }
+}
+
+template <typename Handler>
+bool Parser::parseObject(Handler& handler) {
+    handler.onStartObject();
+    ++__cur;
+    parseWhitespace();
+    std::size_t count = 0;
+    if (peek() == '}') {
+        __start = ++__cur;
+        handler.onEndObject(count);
+        return true;
+    }
+    while (1) {
+        parseWhitespace();
+        if (peek() != '"') return fail(ParseError::MISS_KEY);
+        StringView key;
+        if (!parseRawString(key)) return false;
+        handler.onKey(key);
+        parseWhitespace();
+        if (peek() != ':') return fail(ParseError::MISS_COLON);
+        ++__cur;
+        parseWhitespace();
+        if (!parseValue(handler)) return false;
+        ++count;
+        parseWhitespace();
+        if (peek() == ',') ++__cur;
+        else if (peek() == '}'){
+            __start = ++__cur;
+            handler.onEndObject(count);
+            return true;
+        }else return fail(ParseError::MISS_COMMA_OR_CURLY_BRACKET);
+    }
+}
+
 }   // namespace json
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,56 @@
+#include "parseError.h"
+#include <cstring>
+using namespace std;
+
+namespace json {
+
+constexpr size_t ParseError::kContextSize;
+
+const char* ParseError::message(Code code) noexcept {
+    switch (code) {
+        case OK : return "OK";
+        case EXPECT_VALUE : return "EXPECT VALUE";
+        case INVALID_VALUE : return "INVALID VALUE";
+        case ROOT_NOT_SINGULAR : return "ROOT NOT SINGULAR";
+        case NUMBER_TOO_BIG : return "NUMBER TOO BIG";
+        case MISS_QUOTATION_MARK : return "MISS QUOTATION MARK";
+        case INVALID_STRING_ESCAPE : return "INVALID STRING ESCAPE";
+        case INVALID_STRING_CHAR : return "INVALID STRING CHAR";
+        case INVALID_UNICODE_HEX : return "INVALID UNICODE HEX";
+        case INVALID_UNICODE_SURROGATE : return "INVALID UNICODE SURROGATE";
+        case MISS_COMMA_OR_SQUARE_BRACKET : return "MISS COMMA OR SQUARE BRACKET";
+        case MISS_KEY : return "MISS KEY";
+        case MISS_COLON : return "MISS COLON";
+        case MISS_COMMA_OR_CURLY_BRACKET : return "MISS COMMA OR CURLY BRACKET";
+        case INVALID_UTF8 : return "INVALID UTF8";
+    }
+    return "UNKNOWN ERROR";
+}
+
+string ParseError::str() const {
+    return string(message()) + ": line " + to_string(line) + ", column " + to_string(column) + ": " + context;
+}
+
+void ParseError::set(Code code, const char* begin, const char* pos, const char* end,
+                     size_t offset, size_t line, size_t column) noexcept {
+    // json has no new line outside of whitespace, counting them is all it takes
+    const char* lineStart = begin;
+    while (const void* nl = memchr(lineStart, '\n', pos - lineStart)) {
+        ++line;
+        lineStart = static_cast<const char*>(nl) + 1;
+    }
+    setAt(code, pos, end, offset + (pos - begin), line, (lineStart == begin ? column : 1) + (pos - lineStart));
+}
+
+void ParseError::setAt(Code code, const char* pos, const char* end,
+                       size_t offset, size_t line, size_t column) noexcept {
+    this->code = code;
+    this->offset = offset;
+    this->line = line;
+    this->column = column;
+    size_t n = 0;
+    for (const char* p = pos; p != end && n != kContextSize && *p && *p != '\n' && *p != '\r'; ++p) context[n++] = *p;
+    context[n] = '\0';
+}
+
+}   // namespace json
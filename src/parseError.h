@@ -0,0 +1,57 @@
+#ifndef _PARSEERROR_H_
+#define _PARSEERROR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace json {
+
+// why and where a document was rejected. filling it neither allocates nor
+// copies more than kContextSize chars of the input, whatever its size.
+struct ParseError {
+    enum Code : std::uint8_t {
+        OK,
+        EXPECT_VALUE,
+        INVALID_VALUE,
+        ROOT_NOT_SINGULAR,
+        NUMBER_TOO_BIG,
+        MISS_QUOTATION_MARK,
+        INVALID_STRING_ESCAPE,
+        INVALID_STRING_CHAR,
+        INVALID_UNICODE_HEX,
+        INVALID_UNICODE_SURROGATE,
+        MISS_COMMA_OR_SQUARE_BRACKET,
+        MISS_KEY,
+        MISS_COLON,
+        MISS_COMMA_OR_CURLY_BRACKET,
+        INVALID_UTF8        // only checked by Parser::validate()
+    };
+    static constexpr std::size_t kContextSize = 32;
+
+    Code code = OK;
+    std::size_t offset = 0;     // bytes before the char where the error was found
+    std::size_t line = 0;       // of that char, from 1 (0 if there is no error)
+    std::size_t column = 0;     // bytes from the start of its line, from 1
+    // the input from that char on, up to the end of the line or kContextSize chars
+    char context[kContextSize + 1] = {};
+
+    explicit operator bool() const noexcept { return code != OK; }
+    // "INVALID VALUE", ...
+    static const char* message(Code code) noexcept;
+    const char* message() const noexcept { return message(code); }
+    // message, position and context: "MISS COLON: line 2, column 9: 1}"
+    std::string str() const;
+
+    // the error code at pos, in a buffer [begin, end) where begin is at
+    // offset/line/column of the document (its start by default)
+    void set(Code code, const char* begin, const char* pos, const char* end,
+             std::size_t offset = 0, std::size_t line = 1, std::size_t column = 1) noexcept;
+    // the same when the position of pos is known: nothing before it is read
+    void setAt(Code code, const char* pos, const char* end,
+               std::size_t offset, std::size_t line, std::size_t column) noexcept;
+};
+
+}   // namespace json
+
+#endif
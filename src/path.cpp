@@ -0,0 +1,353 @@
+#include "path.h"
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include "jsonException.h"
+#include "parse.h"
+using namespace std;
+
+namespace json {
+
+namespace {
+
+constexpr size_t npos = static_cast<size_t>(-1);
+
+inline bool isDigit(char ch) noexcept {
+    return ch >= '0' && ch <= '9';
+}
+
+inline bool isNameChar(char ch) noexcept {
+    return isDigit(ch) || (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+// "0" or digits without a leading zero, npos otherwise (or if too large)
+size_t arrayIndex(const string& token) noexcept {
+    if (token.empty() || token.size() > 18 || (token[0] == '0' && token.size() > 1)) return npos;
+    size_t index = 0;
+    for (char ch : token) {
+        if (!isDigit(ch)) return npos;
+        index = index * 10 + (ch - '0');
+    }
+    return index;
+}
+
+const Json* child(const Json& json, const string& key, size_t index) noexcept {
+    if (json.isObject()) {
+        const Json::object_t& obj = json.toObject();
+        auto it = obj.find(String::view(key));
+        return it == obj.end() ? nullptr : &it->second;
+    }
+    if (json.isArray() && index < json.size()) return &json.toArray()[index];
+    return nullptr;
+}
+
+}   // namespace
+
+JsonPointer::JsonPointer(StringView pointer) {
+    const char* p = pointer.data();
+    const char* end = p + pointer.size();
+    if (p != end && *p != '/') throwException(JsonException("invalid json pointer: " + pointer.str()));
+    while (p != end) {
+        string key;
+        for (++p; p != end && *p != '/'; ++p) {
+            if (*p != '~') key += *p;
+            else if (end - p > 1 && (p[1] == '0' || p[1] == '1')) key += *++p == '0' ? '~' : '/';
+            else throwException(JsonException("invalid json pointer: " + pointer.str()));
+        }
+        size_t index = arrayIndex(key);
+        __tokens.push_back({std::move(key), index});
+    }
+}
+
+const Json* JsonPointer::find(const Json& root) const noexcept {
+    const Json* json = &root;
+    for (const Token& token : __tokens) {
+        json = child(*json, token.key, token.index);
+        if (!json) break;
+    }
+    return json;
+}
+
+Json* JsonPointer::find(Json& root) const noexcept {
+    // the same path through the non-const accessors, which make the values
+    // on the way unshared (see Json::Json(const Json&))
+    if (!find(static_cast<const Json&>(root))) return nullptr;
+    Json* json = &root;
+    for (const Token& token : __tokens) {
+        if (json->isObject()) json = &(*json)[token.key];
+        else json = &(*json)[token.index];
+    }
+    return json;
+}
+
+JsonPath::JsonPath(StringView path) {
+    const char* p = path.data();
+    const char* end = p + path.size();
+    auto fail = [&path]() { throwException(JsonException("invalid json path: " + path.str())); };
+    // optional integer, hasInt tells if there is one
+    auto parseInt = [&](bool& hasInt) -> int64_t {
+        bool neg = p != end && *p == '-';
+        if (neg) ++p;
+        const char* digits = p;
+        int64_t val = 0;
+        for (; p != end && isDigit(*p); ++p) {
+            if (p - digits == 18) fail();
+            val = val * 10 + (*p - '0');
+        }
+        hasInt = p != digits;
+        if (neg && !hasInt) fail();
+        return neg ? -val : val;
+    };
+
+    if (p == end || *p != '$') fail();
+    for (++p; p != end;) {
+        Step step{Step::NAME, false, false, string(), 0, 0, 1};
+        if (*p == '.') {
+            if (++p != end && *p == '*') {
+                step.kind = Step::WILDCARD;
+                ++p;
+            } else {
+                const char* name = p;
+                while (p != end && isNameChar(*p)) ++p;
+                if (p == name) fail();
+                step.name.assign(name, p);
+            }
+        } else if (*p == '[') {
+            if (++p == end) fail();
+            if (*p == '*') {
+                step.kind = Step::WILDCARD;
+                ++p;
+            } else if (*p == '\'' || *p == '\"') {
+                char quote = *p++;
+                for (; p != end && *p != quote; ++p) {
+                    if (*p == '\\' && ++p == end) fail();
+                    step.name += *p;
+                }
+                if (p == end) fail();
+                ++p;
+            } else {
+                step.kind = Step::INDEX;
+                step.start = parseInt(step.hasStart);
+                if (p != end && *p == ':') {
+                    step.kind = Step::SLICE;
+                    ++p;
+                    step.end = parseInt(step.hasEnd);
+                    if (p != end && *p == ':') {
+                        ++p;
+                        bool hasStep;
+                        step.step = parseInt(hasStep);
+                        if (!hasStep) step.step = 1;
+                        if (step.step == 0) fail();
+                    }
+                } else if (!step.hasStart) fail();
+            }
+            if (p == end || *p != ']') fail();
+            ++p;
+        } else fail();
+        __steps.push_back(std::move(step));
+    }
+}
+
+template <typename F>
+bool JsonPath::walk(const Json& json, size_t i, F& f) const {
+    if (i == __steps.size()) return f(&json);
+    const Step& step = __steps[i];
+    switch (step.kind) {
+        case Step::NAME : {
+            if (!json.isObject()) return true;
+            const Json::object_t& obj = json.toObject();
+            auto it = obj.find(String::view(step.name));
+            return it == obj.end() || walk(it->second, i + 1, f);
+        }
+        case Step::INDEX : {
+            if (!json.isArray()) return true;
+            int64_t n = static_cast<int64_t>(json.size());
+            int64_t index = step.start < 0 ? step.start + n : step.start;
+            return index < 0 || index >= n || walk(json.toArray()[index], i + 1, f);
+        }
+        case Step::SLICE : {
+            if (!json.isArray()) return true;
+            const Json::array_t& arr = json.toArray();
+            int64_t n = static_cast<int64_t>(arr.size());
+            // as in Python: negative bounds count from the end, then are clamped
+            auto bound = [n](int64_t val, int64_t lo, int64_t hi) { return min(max(val < 0 ? val + n : val, lo), hi); };
+            if (step.step > 0) {
+                int64_t start = step.hasStart ? bound(step.start, 0, n) : 0;
+                int64_t end = step.hasEnd ? bound(step.end, 0, n) : n;
+                for (int64_t k = start; k < end; k += step.step)
+                    if (!walk(arr[k], i + 1, f)) return false;
+            } else {
+                int64_t start = step.hasStart ? bound(step.start, -1, n - 1) : n - 1;
+                int64_t end = step.hasEnd ? bound(step.end, -1, n - 1) : -1;
+                for (int64_t k = start; k > end; k += step.step)
+                    if (!walk(arr[k], i + 1, f)) return false;
+            }
+            return true;
+        }
+        case Step::WILDCARD : {
+            if (json.isArray()) {
+                for (const Json& elem : json.toArray())
+                    if (!walk(elem, i + 1, f)) return false;
+            } else if (json.isObject()) {
+                for (const auto& member : json.toObject())
+                    if (!walk(member.second, i + 1, f)) return false;
+            }
+            return true;
+        }
+    }
+    return true;
+}
+
+void JsonPath::evaluate(const Json& root, vector<const Json*>& out) const {
+    auto append = [&out](const Json* json) {
+        out.push_back(json);
+        return true;
+    };
+    walk(root, 0, append);
+}
+
+const Json* JsonPath::first(const Json& root) const noexcept {
+    const Json* result = nullptr;
+    auto stop = [&result](const Json* json) {
+        result = json;
+        return false;
+    };
+    walk(root, 0, stop);
+    return result;
+}
+
+// a node of the trie of the pointers
+struct PathFilter::Node {
+    bool selected = false;  // a pointer ends here, the whole value is kept
+    std::string key;
+    std::unordered_map<String, Node*, StringHash> children;     // keys refer to their key
+    std::map<size_t, Node*> indexes;    // children whose token is an array index
+};
+
+// forwards to a DomBuilder the events of the values on the way to the selected ones
+// and of the selected ones, drops the others
+class PathFilter::Handler final : public SaxHandler<Handler> {
+public:
+    explicit Handler(const Node* root) noexcept : __root(root), __copy(0), __skip(0) {}
+
+    void onNull() { if (scalar()) __builder.onNull(); }
+    void onBool(bool val) { if (scalar()) __builder.onBool(val); }
+    void onDouble(double val) { if (scalar()) __builder.onDouble(val); }
+    void onInt64(int64_t val) { if (scalar()) __builder.onInt64(val); }
+    void onUint64(uint64_t val) { if (scalar()) __builder.onUint64(val); }
+    void onString(StringView str) { if (scalar()) __builder.onString(str); }
+    void onStartObject() { if (start(false)) __builder.onStartObject(); }
+    void onKey(StringView str) {
+        if (__copy) __builder.onKey(str);
+        else if (!__skip) {
+            Frame& top = __stack.back();
+            auto it = top.node->children.find(String::view(str));
+            top.pending = it == top.node->children.end() ? nullptr : it->second;
+        }
+    }
+    void onEndObject(size_t count) { if (end(count)) __builder.onEndObject(count); }
+    void onStartArray() { if (start(true)) __builder.onStartArray(); }
+    void onEndArray(size_t count) { if (end(count)) __builder.onEndArray(count); }
+
+    Json& root() noexcept { return __builder.root(); }
+
+private:
+    // a container on the way to selected values
+    struct Frame {
+        const Node* node;
+        bool array;
+        size_t index;       // of the next element
+        size_t kept;        // elements or members given to the builder
+        const Node* pending;    // node of the last key, nullptr if it is not in the trie
+    };
+
+    bool scalar() {
+        if (__copy || __skip) return __copy != 0;
+        const Node* node = enter(false);
+        return node != nullptr;
+    }
+    bool start(bool array) {
+        if (__copy) {
+            ++__copy;
+            return true;
+        }
+        if (__skip) {
+            ++__skip;
+            return false;
+        }
+        const Node* node = enter(true);
+        if (!node) __skip = 1;
+        else if (node->selected) __copy = 1;
+        else __stack.push_back({node, array, 0, 0, nullptr});
+        return node != nullptr;
+    }
+    bool end(size_t& count) {
+        if (__copy) {
+            --__copy;
+            return true;
+        }
+        if (__skip) {
+            --__skip;
+            return false;
+        }
+        count = __stack.back().kept;
+        __stack.pop_back();
+        return true;
+    }
+    // a value starts outside of selected values: its node if it is kept
+    const Node* enter(bool container) {
+        if (__stack.empty()) return container || __root->selected ? __root : nullptr;
+        Frame& top = __stack.back();
+        const Node* node;
+        size_t index = top.index;
+        if (top.array) {
+            auto it = top.node->indexes.find(top.index++);
+            node = it == top.node->indexes.end() ? nullptr : it->second;
+        } else node = top.pending;
+        if (!node || (!container && !node->selected)) return nullptr;
+        if (top.array) {
+            for (; top.kept < index; ++top.kept) __builder.onNull();
+        } else __builder.onKey(node->key);
+        ++top.kept;
+        return node;
+    }
+
+    DomBuilder __builder;
+    const Node* __root;
+    std::vector<Frame> __stack;
+    size_t __copy;      // depth in a selected value
+    size_t __skip;      // depth in a dropped value
+};
+
+PathFilter::PathFilter(const vector<JsonPointer>& pointers) {
+    __nodes.emplace_back(new Node());
+    for (const JsonPointer& pointer : pointers) {
+        Node* node = __nodes[0].get();
+        for (size_t i = 0; i < pointer.size(); ++i) node = child(node, pointer.token(i));
+        node->selected = true;
+    }
+}
+
+PathFilter::~PathFilter() = default;
+
+PathFilter::Node* PathFilter::child(Node* node, const string& token) {
+    auto it = node->children.find(String::view(token));
+    if (it != node->children.end()) return it->second;
+    __nodes.emplace_back(new Node());
+    Node* child = __nodes.back().get();
+    child->key = token;
+    node->children.emplace(String::view(child->key), child);
+    size_t index = arrayIndex(token);
+    if (index != npos) node->indexes.emplace(index, child);
+    return child;
+}
+
+Json PathFilter::parse(StringView content, string& errmsg) const noexcept {
+    Handler handler(__nodes[0].get());
+    ParseError error;
+    if (Parser(content).parse(handler, error)) return std::move(handler.root());
+    errmsg = error.str();
+    return Json(nullptr);
+}
+
+}   // namespace json
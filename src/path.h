@@ -0,0 +1,96 @@
+#ifndef _PATH_H_
+#define _PATH_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "json.h"
+#include "stringView.h"
+#include "uncopyable.h"
+
+namespace json {
+
+// RFC 6901 JSON Pointer, e.g. "/store/book/0/title" ("" is the whole document,
+// "~0" and "~1" stand for '~' and '/' in a token).
+// it is compiled once and can be applied to any number of documents;
+// lookups return a pointer into the document, nullptr if there is no such value.
+class JsonPointer {
+public:
+    // throws JsonException if pointer is not a valid JSON Pointer
+    explicit JsonPointer(StringView pointer);
+
+    const Json* find(const Json& root) const noexcept;
+    Json* find(Json& root) const noexcept;
+
+    std::size_t size() const noexcept { return __tokens.size(); }
+    // i-th token, unescaped
+    const std::string& token(std::size_t i) const noexcept { return __tokens[i].key; }
+
+private:
+    struct Token {
+        std::string key;
+        std::size_t index;      // key as an array index, npos if it is not one
+    };
+
+    std::vector<Token> __tokens;
+};
+
+// small path language, compiled once and evaluated against any number of documents:
+//   $             the root
+//   .name         member of an object (name is made of letters, digits and '_')
+//   ['name']      member of an object, any name ('\'' and '\\' escaped by '\\')
+//   [n]           element of an array, negative n counts from the end
+//   [start:end:step]   elements of an array as in a Python slice, each part optional
+//   .* or [*]     all the members of an object or all the elements of an array
+// e.g. "$.store.book[*].author", "$['a b'][-1]", "$.items[:10:2].id".
+// evaluation appends pointers into the document, without copying any value.
+class JsonPath {
+public:
+    // throws JsonException if path is not a valid path
+    explicit JsonPath(StringView path);
+
+    // appends the values selected in root to out, in document order
+    void evaluate(const Json& root, std::vector<const Json*>& out) const;
+    // first value selected in root, nullptr if there is none
+    const Json* first(const Json& root) const noexcept;
+
+private:
+    struct Step {
+        enum Kind : std::uint8_t { NAME, INDEX, SLICE, WILDCARD } kind;
+        bool hasStart, hasEnd;
+        std::string name;
+        std::int64_t start, end, step;  // INDEX uses start
+    };
+
+    template <typename F>
+    bool walk(const Json& json, std::size_t step, F& f) const;
+
+    std::vector<Step> __steps;
+};
+
+// parses documents keeping only the values selected by a set of pointers,
+// and the containers on the way to them: members of an object that lead to
+// no selected value are left out, elements of an array are replaced by null
+// (up to the last kept one) so that the pointers find the same values.
+// the rest of the document is validated as usual but not built.
+class PathFilter final : uncopyable {
+public:
+    explicit PathFilter(const std::vector<JsonPointer>& pointers);
+    ~PathFilter();
+
+    // same errors as Json::parse
+    Json parse(StringView content, std::string& errmsg) const noexcept;
+
+private:
+    struct Node;
+    class Handler;
+
+    Node* child(Node* node, const std::string& token);
+
+    std::vector<std::unique_ptr<Node>> __nodes;     // __nodes[0] is the root
+};
+
+}   // namespace json
+
+#endif
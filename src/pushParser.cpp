@@ -0,0 +1,329 @@
+#include "pushParser.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include "jsonException.h"
+#include "parse.h"
+#include "scan.h"
+using namespace std;
+
+namespace json {
+
+namespace {
+// states of the number grammar
+enum : uint8_t { nSTART, nSIGN, nZERO, nINT, nDOT, nFRAC, nE, nESIGN, nEXP, nDONE, nERROR };
+
+constexpr bool is1to9(char ch) { return ch >= '1' && ch <= '9'; }
+constexpr bool is0to9(char ch) { return ch >= '0' && ch <= '9'; }
+constexpr bool isExp(char ch) { return ch == 'e' || ch == 'E'; }
+
+uint8_t nextNumberState(uint8_t state, char ch) noexcept {
+    switch (state) {
+        case nSTART : return ch == '-' ? nSIGN : ch == '0' ? nZERO : is1to9(ch) ? nINT : nERROR;
+        case nSIGN : return ch == '0' ? nZERO : is1to9(ch) ? nINT : nERROR;
+        case nZERO : return ch == '.' ? nDOT : isExp(ch) ? nE : nDONE;
+        case nINT : return is0to9(ch) ? nINT : ch == '.' ? nDOT : isExp(ch) ? nE : nDONE;
+        case nDOT : return is0to9(ch) ? nFRAC : nERROR;
+        case nFRAC : return is0to9(ch) ? nFRAC : isExp(ch) ? nE : nDONE;
+        case nE : return ch == '-' || ch == '+' ? nESIGN : is0to9(ch) ? nEXP : nERROR;
+        case nESIGN : return is0to9(ch) ? nEXP : nERROR;
+        default : return is0to9(ch) ? nEXP : nDONE;
+    }
+}
+}   // namespace
+
+// the value of a complete number token goes through Parser, so both agree on it
+struct PushParserBase::NumberEvents : SaxHandler<NumberEvents> {
+    explicit NumberEvents(PushParserBase& parser) noexcept : parser(parser) {}
+    void onDouble(double val) { parser.onDouble(val); }
+    void onInt64(int64_t val) { parser.onInt64(val); }
+    void onUint64(uint64_t val) { parser.onUint64(val); }
+
+    PushParserBase& parser;
+};
+
+void PushParserBase::feed(StringView chunk) {
+    // the message only holds a bounded context, not the rest of the chunk
+    if (!feedChunk(chunk)) throwException(JsonException(__error.str()));
+}
+
+bool PushParserBase::feed(StringView chunk, ParseError& error) {
+    bool ok = feedChunk(chunk);
+    error = __error;
+    return ok;
+}
+
+bool PushParserBase::feedChunk(StringView chunk) {
+    const char* p = chunk.data();
+    const char* end = p + chunk.size();
+    __chunkBegin = p;
+    __chunkEnd = end;
+    while (p != end && __state != sEND) {
+        switch (__state) {
+            case sSTRING : p = parseString(p, end); break;
+            case sNUMBER : p = parseNumber(p, end); break;
+            case sLITERAL : p = parseLiteral(p, end); break;
+            default : p = parseStructural(p, end); break;
+        }
+        if (!p) return false;
+    }
+    // where the next chunk starts, for the errors
+    __offset += chunk.size();
+    const char* lineStart = chunk.data();
+    while (const void* nl = memchr(lineStart, '\n', end - lineStart)) {
+        ++__line;
+        lineStart = static_cast<const char*>(nl) + 1;
+    }
+    __column = (lineStart == chunk.data() ? __column : 1) + (end - lineStart);
+    return true;
+}
+
+// the end of the input is a NUL char, as for Parser
+static const char nul = '\0';
+
+void PushParserBase::finish() {
+    feed(StringView(&nul, 1));
+}
+
+bool PushParserBase::finish(ParseError& error) {
+    return feed(StringView(&nul, 1), error);
+}
+
+const char* PushParserBase::parseStructural(const char* p, const char* end) {
+    if (isWhitespace(*p)) {
+        p = skipWhitespace(p, end);
+        if (p == end) return p;
+    }
+    char ch = *p;
+    switch (__state) {
+        case sARRAY_FIRST :
+            if (ch == ']') {
+                endContainer();
+                return p + 1;
+            }
+            return parseValue(p, end);
+        case sVALUE : return parseValue(p, end);
+        case sOBJECT_FIRST :
+            if (ch == '}') {
+                endContainer();
+                return p + 1;
+            }
+            // fall through
+        case sKEY :
+            if (ch != '\"') return fail(ParseError::MISS_KEY, p);
+            __key = true;
+            __buf.clear();
+            __state = sSTRING;
+            return parseString(p + 1, end);
+        case sCOLON :
+            if (ch != ':') return fail(ParseError::MISS_COLON, p);
+            __state = sVALUE;
+            return p + 1;
+        default :   // sAFTER_VALUE
+            if (__stack.empty()) {
+                if (ch != '\0') return fail(ParseError::ROOT_NOT_SINGULAR, p);
+                __state = sEND;
+                return end;
+            }
+            bool object = __stack.back().object;
+            if (ch == ',') __state = object ? sKEY : sVALUE;
+            else if (ch == (object ? '}' : ']')) endContainer();
+            else return fail(object ? ParseError::MISS_COMMA_OR_CURLY_BRACKET : ParseError::MISS_COMMA_OR_SQUARE_BRACKET, p);
+            return p + 1;
+    }
+}
+
+const char* PushParserBase::parseValue(const char* p, const char* end) {
+    switch (*p) {
+        case 'n' : __literal = "null"; break;
+        case 't' : __literal = "true"; break;
+        case 'f' : __literal = "false"; break;
+        case '\"' :
+            __key = false;
+            __buf.clear();
+            __state = sSTRING;
+            return parseString(p + 1, end);
+        case '[' :
+            onStartArray();
+            __stack.push_back({false, 0});
+            __state = sARRAY_FIRST;
+            return p + 1;
+        case '{' :
+            onStartObject();
+            __stack.push_back({true, 0});
+            __state = sOBJECT_FIRST;
+            return p + 1;
+        case '\0' : return fail(ParseError::EXPECT_VALUE, p);
+        default :
+            __number = nSTART;
+            __buf.clear();
+            __state = sNUMBER;
+            return parseNumber(p, end);
+    }
+    __matched = 0;
+    __state = sLITERAL;
+    return parseLiteral(p, end);
+}
+
+const char* PushParserBase::parseString(const char* p, const char* end) {
+    if (__escape) {
+        p = parseEscape(p, end);
+        if (__escape) return p;
+    }
+    const char* run = p;    // first char not yet in __buf
+    for (;;) {
+        p = scanString(p, end);
+        if (p == end) {
+            __buf.append(run, p - run);
+            return p;
+        }
+        switch (*p) {
+            case '\"' : {
+                // nothing buffered: the string is a view of the chunk
+                StringView str(run, p - run);
+                if (!__buf.empty()) str = __buf.append(run, p - run);
+                if (__key) {
+                    onKey(str);
+                    __state = sCOLON;
+                } else {
+                    onString(str);
+                    endValue();
+                }
+                return p + 1;
+            }
+            case '\\' :
+                __buf.append(run, p - run);
+                __escape = 1;
+                p = parseEscape(p + 1, end);
+                if (__escape) return p;
+                run = p;
+                break;
+            case '\0' : return fail(ParseError::MISS_QUOTATION_MARK, p);
+            default : return fail(ParseError::INVALID_STRING_CHAR, p);
+        }
+    }
+}
+
+const char* PushParserBase::parseEscape(const char* p, const char* end) {
+    // __escape is 1 after '\\', 2-5 on the hex digits of \uXXXX,
+    // then 6 and 7 on the "\u" of a low surrogate, and 8-11 on its hex digits
+    for (; p != end; ++p) {
+        char ch = *p;
+        switch (__escape) {
+            case 1 :
+                switch (ch) {
+                    case '\"' : case '\\' : case '/' : __buf.push_back(ch); break;
+                    case 'b' : __buf.push_back('\b'); break;
+                    case 'f' : __buf.push_back('\f'); break;
+                    case 'n' : __buf.push_back('\n'); break;
+                    case 't' : __buf.push_back('\t'); break;
+                    case 'r' : __buf.push_back('\r'); break;
+                    case 'u' :
+                        __escape = 2;
+                        __u = 0;
+                        continue;
+                    default : return fail(ParseError::INVALID_STRING_ESCAPE, p);
+                }
+                __escape = 0;
+                return p + 1;
+            case 6 :
+                if (ch != '\\') return fail(ParseError::INVALID_UNICODE_SURROGATE, p);
+                __escape = 7;
+                break;
+            case 7 :
+                if (ch != 'u') return fail(ParseError::INVALID_UNICODE_SURROGATE, p);
+                __escape = 8;
+                __u = 0;
+                break;
+            default : {
+                unsigned hex = static_cast<unsigned>(toupper(ch));
+                if (hex >= '0' && hex <= '9') hex -= '0';
+                else if (hex >= 'A' && hex <= 'F') hex -= 'A' - 10;
+                else return fail(ParseError::INVALID_UNICODE_HEX, p);
+                __u = (__u << 4) | hex;
+                if (++__escape == 6) {
+                    if (__u >= 0xd800 && __u <= 0xdbff) {   // high surrogate
+                        __high = __u;
+                        break;
+                    }
+                    appendUTF8(__u);
+                    __escape = 0;
+                    return p + 1;
+                }
+                if (__escape == 12) {
+                    if (__u < 0xdc00 || __u > 0xdfff) return fail(ParseError::INVALID_UNICODE_SURROGATE, p);
+                    appendUTF8((((__high - 0xd800) << 10) | (__u - 0xdc00)) + 0x10000);
+                    __escape = 0;
+                    return p + 1;
+                }
+            }
+        }
+    }
+    return p;
+}
+
+void PushParserBase::appendUTF8(unsigned u) {
+    char utf8[4];
+    __buf.append(utf8, encodeUTF8(u, utf8));
+}
+
+const char* PushParserBase::parseNumber(const char* p, const char* end) {
+    const char* start = p;
+    for (; p != end; ++p) {
+        uint8_t state = nextNumberState(__number, *p);
+        if (state == nERROR) return fail(ParseError::INVALID_VALUE, p);
+        if (state == nDONE) {
+            // the char after the number is left to the caller
+            StringView token(start, p - start);
+            if (!__buf.empty()) token = __buf.append(start, p - start);
+            NumberEvents events(*this);
+            ParseError error;
+            // NUMBER TOO BIG, at the start of the number like for Parser
+            if (!Parser(token).parse(events, error)) return fail(error.code, start, token.size() - (p - start));
+            endValue();
+            return p;
+        }
+        __number = state;
+    }
+    __buf.append(start, p - start);
+    return p;
+}
+
+const char* PushParserBase::parseLiteral(const char* p, const char* end) {
+    for (; p != end; ++p) {
+        if (*p != __literal[__matched]) return fail(ParseError::INVALID_VALUE, p);
+        if (__literal[++__matched] == '\0') {
+            switch (__literal[0]) {
+                case 'n' : onNull(); break;
+                case 't' : onBool(true); break;
+                default : onBool(false); break;
+            }
+            endValue();
+            return p + 1;
+        }
+    }
+    return p;
+}
+
+void PushParserBase::endValue() noexcept {
+    if (!__stack.empty()) ++__stack.back().count;
+    __state = sAFTER_VALUE;
+}
+
+void PushParserBase::endContainer() {
+    Frame frame = __stack.back();
+    __stack.pop_back();
+    if (frame.object) onEndObject(frame.count);
+    else onEndArray(frame.count);
+    endValue();
+}
+
+const char* PushParserBase::fail(ParseError::Code code, const char* p, size_t before) noexcept {
+    __error.set(code, __chunkBegin, p, __chunkEnd, __offset, __line, __column);
+    // tokens have no new line, the error is on the same line
+    __error.offset -= before;
+    __error.column -= before;
+    return nullptr;
+}
+
+}   // namespace json
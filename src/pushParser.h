@@ -0,0 +1,132 @@
+#ifndef _PUSHPARSER_H_
+#define _PUSHPARSER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "parseError.h"
+#include "stringView.h"
+#include "uncopyable.h"
+
+namespace json {
+
+// incremental parser: the document is given in chunks of any size as they
+// arrive, every chunk is scanned once. a token cut by the end of a chunk
+// (string, escape, number, literal) is resumed with the next one.
+// same grammar, events and errors as Parser::parse(handler): errors are
+// thrown as JsonException, or reported by the overloads taking a ParseError.
+// the parser must not be used after one.
+// like for Parser, a NUL char ends the document.
+class PushParserBase : uncopyable {
+public:
+    virtual ~PushParserBase() = default;
+
+    // events of complete values are reported before it returns
+    void feed(StringView chunk);
+    bool feed(StringView chunk, ParseError& error);
+    // end of the input: throws (or returns false) if the document is not complete
+    void finish();
+    bool finish(ParseError& error);
+    // true once the root value is complete (a number only when a char follows it)
+    bool done() const noexcept { return __state == sEND || (__state == sAFTER_VALUE && __stack.empty()); }
+    // what made feed() or finish() fail, if they did. offset, line and column
+    // count from the first chunk, the context comes from the chunk of the error
+    const ParseError& error() const noexcept { return __error; }
+
+protected:
+    PushParserBase() : __state(sVALUE) {}
+
+    virtual void onNull() = 0;
+    virtual void onBool(bool val) = 0;
+    virtual void onDouble(double val) = 0;
+    virtual void onInt64(std::int64_t val) = 0;
+    virtual void onUint64(std::uint64_t val) = 0;
+    virtual void onString(StringView str) = 0;
+    virtual void onStartObject() = 0;
+    virtual void onKey(StringView str) = 0;
+    virtual void onEndObject(std::size_t memberCount) = 0;
+    virtual void onStartArray() = 0;
+    virtual void onEndArray(std::size_t elementCount) = 0;
+
+private:
+    struct NumberEvents;
+
+    enum State : std::uint8_t {
+        sVALUE,         // a value is expected
+        sARRAY_FIRST,   // after '[': a value or ']'
+        sOBJECT_FIRST,  // after '{': a key or '}'
+        sKEY,           // after ',' in an object
+        sCOLON,         // after a key
+        sAFTER_VALUE,   // ',' or the end of the container, or the end of the document
+        sSTRING,
+        sNUMBER,
+        sLITERAL,
+        sEND
+    };
+    struct Frame {
+        bool object;
+        std::size_t count;
+    };
+
+    // false at the first error, which is in __error
+    bool feedChunk(StringView chunk);
+    // each of them consumes chars of [p, end) and returns where it stopped,
+    // or nullptr at an error
+    const char* parseStructural(const char* p, const char* end);
+    const char* parseValue(const char* p, const char* end);
+    const char* parseString(const char* p, const char* end);
+    const char* parseEscape(const char* p, const char* end);
+    const char* parseNumber(const char* p, const char* end);
+    const char* parseLiteral(const char* p, const char* end);
+    void appendUTF8(unsigned u);
+    void endValue() noexcept;
+    void endContainer();
+    // error at p, or before chars before it for a token started in previous chunks.
+    // returns nullptr
+    const char* fail(ParseError::Code code, const char* p, std::size_t before = 0) noexcept;
+
+    State __state;
+    std::vector<Frame> __stack;     // open containers
+    // token in progress
+    std::string __buf;      // chars of the token from previous chunks (decoded for strings)
+    bool __key = false;     // the string is a key
+    std::uint8_t __escape = 0;      // position in an escape sequence, 0 outside of one
+    unsigned __u = 0;       // code point of a \u escape
+    unsigned __high = 0;    // high surrogate of a pair
+    std::uint8_t __number = 0;      // state of the number grammar
+    const char* __literal = nullptr;    // "null", "true" or "false"
+    std::size_t __matched = 0;      // chars of __literal already matched
+    const char* __chunkBegin = nullptr;
+    const char* __chunkEnd = nullptr;
+    // position of the current chunk in the document
+    std::size_t __offset = 0;
+    std::size_t __line = 1;
+    std::size_t __column = 1;
+    ParseError __error;
+};
+
+// reports the events to handler (see SaxHandler), DomBuilder builds a Json.
+template <typename Handler>
+class PushParser final : public PushParserBase {
+public:
+    explicit PushParser(Handler& handler) noexcept : __handler(handler) {}
+
+private:
+    void onNull() override { __handler.onNull(); }
+    void onBool(bool val) override { __handler.onBool(val); }
+    void onDouble(double val) override { __handler.onDouble(val); }
+    void onInt64(std::int64_t val) override { __handler.onInt64(val); }
+    void onUint64(std::uint64_t val) override { __handler.onUint64(val); }
+    void onString(StringView str) override { __handler.onString(str); }
+    void onStartObject() override { __handler.onStartObject(); }
+    void onKey(StringView str) override { __handler.onKey(str); }
+    void onEndObject(std::size_t memberCount) override { __handler.onEndObject(memberCount); }
+    void onStartArray() override { __handler.onStartArray(); }
+    void onEndArray(std::size_t elementCount) override { __handler.onEndArray(elementCount); }
+
+    Handler& __handler;
+};
+
+}   // namespace json
+
+#endif
@@ -0,0 +1,341 @@
+#include "scan.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define JSON_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace json {
+
+namespace {
+
+inline bool isPlain(char ch) noexcept {
+    return static_cast<unsigned char>(ch) >= 0x20 && ch != '\"' && ch != '\\';
+}
+
+// bit i of each mask describes block[i]
+struct BlockMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;        // {}[]:,
+};
+
+const char* scanStringScalar(const char* p, const char* end) noexcept {
+    while (p != end && isPlain(*p)) ++p;
+    return p;
+}
+
+const char* skipWhitespaceScalar(const char* p, const char* end) noexcept {
+    while (p != end && isWhitespace(*p)) ++p;
+    return p;
+}
+
+void classifyScalar(const char* block, BlockMasks& m) noexcept {
+    m.quote = m.backslash = m.op = 0;
+    for (int i = 0; i != 64; ++i) {
+        uint64_t bit = 1ULL << i;
+        switch (block[i]) {
+            case '\"' : m.quote |= bit; break;
+            case '\\' : m.backslash |= bit; break;
+            case '{' : case '}' : case '[' : case ']' : case ':' : case ',' : m.op |= bit; break;
+            default : break;
+        }
+    }
+}
+
+#ifdef JSON_SCAN_X86
+const char* scanStringSSE2(const char* p, const char* end) noexcept {
+    const __m128i quote = _mm_set1_epi8('\"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // x <= 0x1f (unsigned) <=> max(x, 0x1f) == 0x1f
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, slash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(x, ctrl), ctrl));
+        int mask = _mm_movemask_epi8(special);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return scanStringScalar(p, end);
+}
+
+const char* skipWhitespaceSSE2(const char* p, const char* end) noexcept {
+    for (; end - p >= 16; p += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\t')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\r'))));
+        int mask = ~_mm_movemask_epi8(ws) & 0xffff;
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return skipWhitespaceScalar(p, end);
+}
+
+inline uint64_t eqMask16(__m128i x, char ch) noexcept {
+    return static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8(ch))));
+}
+
+void classifySSE2(const char* block, BlockMasks& m) noexcept {
+    m.quote = m.backslash = m.op = 0;
+    for (int i = 0; i != 4; ++i) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+        m.quote |= eqMask16(x, '\"') << (16 * i);
+        m.backslash |= eqMask16(x, '\\') << (16 * i);
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('{')), _mm_cmpeq_epi8(x, _mm_set1_epi8('}'))),
+                                  _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('[')), _mm_cmpeq_epi8(x, _mm_set1_epi8(']'))));
+        op = _mm_or_si128(op, _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(':')), _mm_cmpeq_epi8(x, _mm_set1_epi8(','))));
+        m.op |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(op))) << (16 * i);
+    }
+}
+
+__attribute__((target("avx2")))
+const char* scanStringAVX2(const char* p, const char* end) noexcept {
+    const __m256i quote = _mm256_set1_epi8('\"');
+    const __m256i slash = _mm256_set1_epi8('\\');
+    const __m256i ctrl = _mm256_set1_epi8(0x1f);
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, slash)),
+                                          _mm256_cmpeq_epi8(_mm256_max_epu8(x, ctrl), ctrl));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return scanStringSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+const char* skipWhitespaceAVX2(const char* p, const char* end) noexcept {
+    for (; end - p >= 32; p += 32) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i ws = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r'))));
+        unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(ws));
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    return skipWhitespaceSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+inline uint64_t eqMask32(__m256i x, char ch) noexcept {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(ch))));
+}
+
+__attribute__((target("avx2")))
+void classifyAVX2(const char* block, BlockMasks& m) noexcept {
+    m.quote = m.backslash = m.op = 0;
+    for (int i = 0; i != 2; ++i) {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+        m.quote |= eqMask32(x, '\"') << (32 * i);
+        m.backslash |= eqMask32(x, '\\') << (32 * i);
+        __m256i op = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8('}'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('[')), _mm256_cmpeq_epi8(x, _mm256_set1_epi8(']'))));
+        op = _mm256_or_si256(op, _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(':')),
+                                                 _mm256_cmpeq_epi8(x, _mm256_set1_epi8(','))));
+        m.op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << (32 * i);
+    }
+}
+#endif
+
+struct ScanFuncs {
+    SimdLevel level;
+    const char* (*scanString)(const char*, const char*) noexcept;
+    const char* (*skipWhitespace)(const char*, const char*) noexcept;
+    void (*classify)(const char*, BlockMasks&) noexcept;
+};
+
+ScanFuncs funcsOf(SimdLevel level) noexcept {
+    switch (level) {
+#ifdef JSON_SCAN_X86
+        case SimdLevel::AVX2 : return {level, scanStringAVX2, skipWhitespaceAVX2, classifyAVX2};
+        case SimdLevel::SSE2 : return {level, scanStringSSE2, skipWhitespaceSSE2, classifySSE2};
+#endif
+        default : return {SimdLevel::SCALAR, scanStringScalar, skipWhitespaceScalar, classifyScalar};
+    }
+}
+
+// picked on first use, so parsing during static initialization works too
+ScanFuncs& funcs() noexcept {
+    static ScanFuncs f = funcsOf(detectSimdLevel());
+    return f;
+}
+
+// bits of the chars escaped by a backslash. bit 0 is escaped if carry is set on entry,
+// carry is set on return if the last char of the block is an escaping backslash.
+uint64_t escapedChars(uint64_t backslash, uint64_t& carry) noexcept {
+    uint64_t escaped = carry;
+    uint64_t bs = backslash & ~carry;
+    carry = 0;
+    while (bs) {
+        int i = __builtin_ctzll(bs);
+        if (i == 63) {
+            carry = 1;
+            break;
+        }
+        escaped |= 1ULL << (i + 1);
+        bs &= ~(3ULL << i);     // this backslash, and the one it escapes if any
+    }
+    return escaped;
+}
+
+// bit i = xor of bits 0..i
+uint64_t prefixXor(uint64_t x) noexcept {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+}   // namespace
+
+SimdLevel detectSimdLevel() noexcept {
+#ifdef JSON_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::SCALAR;
+#endif
+}
+
+SimdLevel simdLevel() noexcept {
+    return funcs().level;
+}
+
+void setSimdLevel(SimdLevel level) noexcept {
+    SimdLevel best = detectSimdLevel();
+    funcs() = funcsOf(level < best ? level : best);
+}
+
+const char* scanString(const char* p, const char* end) noexcept {
+    return funcs().scanString(p, end);
+}
+
+const char* skipWhitespace(const char* p, const char* end) noexcept {
+    return funcs().skipWhitespace(p, end);
+}
+
+const char* validateUTF8(const char* p, const char* end) noexcept {
+    const unsigned char* s = reinterpret_cast<const unsigned char*>(p);
+    const unsigned char* e = reinterpret_cast<const unsigned char*>(end);
+    while (s != e) {
+        // runs of ascii, 8 chars at a time
+        while (e - s >= 8) {
+            uint64_t word;
+            memcpy(&word, s, 8);
+            if (word & 0x8080808080808080ULL) break;
+            s += 8;
+        }
+        if (s == e) break;
+        unsigned char ch = *s;
+        if (ch < 0x80) {
+            ++s;
+            continue;
+        }
+        // length of the sequence and range of its second byte (RFC 3629):
+        // no overlong forms, no surrogates, nothing above U+10FFFF
+        size_t n;
+        unsigned char lo = 0x80, hi = 0xBF;
+        if (ch >= 0xC2 && ch <= 0xDF) n = 2;
+        else if (ch >= 0xE0 && ch <= 0xEF) {
+            n = 3;
+            if (ch == 0xE0) lo = 0xA0;
+            else if (ch == 0xED) hi = 0x9F;
+        } else if (ch >= 0xF0 && ch <= 0xF4) {
+            n = 4;
+            if (ch == 0xF0) lo = 0x90;
+            else if (ch == 0xF4) hi = 0x8F;
+        } else break;
+        if (static_cast<size_t>(e - s) < n || s[1] < lo || s[1] > hi) break;
+        size_t i = 2;
+        while (i != n && (s[i] & 0xC0) == 0x80) ++i;
+        if (i != n) break;
+        s += n;
+    }
+    return reinterpret_cast<const char*>(s);
+}
+
+namespace {
+
+// calls f(base, block, op, quote) for the blocks of 64 chars of [p, end) in order,
+// with op the bits of the chars {}[]:, outside of strings and quote the bits of
+// the opening quotes, while f returns true. the last block is padded with spaces.
+template <typename F>
+void forEachBlock(const char* p, const char* end, F f) {
+    auto classify = funcs().classify;
+    uint64_t escapeCarry = 0;
+    uint64_t inString = 0;      // all ones if the previous block ended inside a string
+    char tail[64];
+    for (size_t base = 0; p + base < end; base += 64) {
+        const char* block = p + base;
+        if (end - block < 64) {
+            memset(tail, ' ', sizeof(tail));
+            memcpy(tail, block, end - block);
+            block = tail;
+        }
+        BlockMasks m;
+        classify(block, m);
+        uint64_t escaped = escapedChars(m.backslash, escapeCarry);
+        uint64_t quote = m.quote & ~escaped;
+        // set from an opening quote (included) to its closing quote (excluded)
+        uint64_t str = prefixXor(quote) ^ inString;
+        inString = static_cast<uint64_t>(static_cast<int64_t>(str) >> 63);
+        if (!f(base, block, m.op & ~escaped & ~str, quote & str)) return;
+    }
+}
+
+}   // namespace
+
+bool structuralIndex(const char* p, const char* end, vector<uint32_t>& positions) {
+    positions.clear();
+    if (static_cast<size_t>(end - p) > UINT32_MAX) return false;
+    forEachBlock(p, end, [&](size_t base, const char*, uint64_t op, uint64_t quote) {
+        uint64_t structural = op | quote;
+        while (structural) {
+            positions.push_back(static_cast<uint32_t>(base + __builtin_ctzll(structural)));
+            structural &= structural - 1;
+        }
+        return true;
+    });
+    return true;
+}
+
+bool arraySeparators(const char* p, const char* end, vector<size_t>& positions) {
+    positions.clear();
+    const char* begin = skipWhitespace(p, end);
+    if (begin == end || *begin != '[') return false;
+    size_t depth = 0;
+    bool closed = false;
+    forEachBlock(begin, end, [&](size_t base, const char* block, uint64_t op, uint64_t) {
+        for (; op; op &= op - 1) {
+            int i = __builtin_ctzll(op);
+            switch (block[i]) {
+                case '[' : case '{' :
+                    if (depth++ == 0) positions.push_back(begin - p + base + i);
+                    break;
+                case ']' : case '}' :
+                    if (--depth == 0) {
+                        positions.push_back(begin - p + base + i);
+                        closed = block[i] == ']';
+                        return false;
+                    }
+                    break;
+                case ',' :
+                    if (depth == 1) positions.push_back(begin - p + base + i);
+                    break;
+                default : break;
+            }
+        }
+        return true;
+    });
+    if (!closed) positions.clear();
+    return closed;
+}
+
+}   // namespace json
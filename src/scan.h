@@ -0,0 +1,57 @@
+#ifndef _SCAN_H_
+#define _SCAN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace json {
+
+// vectorized helpers used by the Parser.
+// the implementation is picked at runtime from what the cpu supports,
+// with a scalar fallback on other platforms.
+enum class SimdLevel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// best level supported by the cpu
+SimdLevel detectSimdLevel() noexcept;
+// level currently in use
+SimdLevel simdLevel() noexcept;
+// use a lower level (tests, benchmarks), clamped to detectSimdLevel().
+// not thread safe: call it before parsing starts.
+void setSimdLevel(SimdLevel) noexcept;
+
+inline bool isWhitespace(char ch) noexcept {
+    return ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r';
+}
+
+// first char in [p, end) that cannot be copied verbatim into a string value,
+// i.e. '"', '\\' or a control char; end if there is none.
+const char* scanString(const char* p, const char* end) noexcept;
+// first char in [p, end) that is not whitespace; end if there is none.
+const char* skipWhitespace(const char* p, const char* end) noexcept;
+// first byte in [p, end) that does not start a complete, well-formed UTF-8
+// sequence (RFC 3629: no overlong forms, surrogates or code points above
+// U+10FFFF); end if the whole range is valid.
+const char* validateUTF8(const char* p, const char* end) noexcept;
+
+// structural index of the json text [p, end): offsets of the chars {}[]:,
+// outside of strings and of the opening '"' of every string, in order.
+// a backslash escapes the next char wherever it is (in valid json that is
+// only inside strings), an unterminated string swallows the rest of the text.
+// returns false (and leaves positions empty) if the text is 4GB or longer.
+bool structuralIndex(const char* p, const char* end, std::vector<std::uint32_t>& positions);
+// offsets in [p, end) of the '[' of the array at the root of the json text,
+// of the ',' between its elements and of its closing ']', in order.
+// strings are found as for structuralIndex(), brackets are only counted:
+// the elements themselves are not checked. returns false (and leaves positions
+// empty) if the text does not start with '[' or the array is not closed by a ']'.
+// the text after the ']' is not looked at.
+bool arraySeparators(const char* p, const char* end, std::vector<std::size_t>& positions);
+
+}   // namespace json
+
+#endif
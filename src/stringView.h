@@ -0,0 +1,65 @@
+#ifndef _STRINGVIEW_H_
+#define _STRINGVIEW_H_
+
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace json {
+
+// non-owning reference to a run of chars (C++14 stand-in for std::string_view)
+class StringView {
+public:
+    using const_iterator = const char*;
+
+    StringView() noexcept : __data(""), __size(0) {}
+    StringView(const char* data, std::size_t size) noexcept : __data(data), __size(size) {}
+    StringView(const char* cstr) noexcept : __data(cstr), __size(strlen(cstr)) {}
+    StringView(const std::string& str) noexcept : __data(str.data()), __size(str.size()) {}
+
+    const char* data() const noexcept { return __data; }
+    std::size_t size() const noexcept { return __size; }
+    std::size_t length() const noexcept { return __size; }
+    bool empty() const noexcept { return __size == 0; }
+    const_iterator begin() const noexcept { return __data; }
+    const_iterator end() const noexcept { return __data + __size; }
+    char operator[](std::size_t i) const noexcept { return __data[i]; }
+
+    std::string str() const { return std::string(__data, __size); }
+    operator std::string() const { return str(); }
+
+    int compare(StringView rhs) const noexcept {
+        int ret = memcmp(__data, rhs.__data, __size < rhs.__size ? __size : rhs.__size);
+        if (ret) return ret;
+        return __size < rhs.__size ? -1 : (__size > rhs.__size ? 1 : 0);
+    }
+    // FNV-1a
+    std::size_t hash() const noexcept {
+        std::size_t h = 14695981039346656037ULL;
+        for (char ch : *this) h = (h ^ static_cast<unsigned char>(ch)) * 1099511628211ULL;
+        return h;
+    }
+
+private:
+    const char* __data;
+    std::size_t __size;
+};
+
+inline bool operator== (StringView lhs, StringView rhs) noexcept {
+    // interned keys (see KeyPool) share their chars
+    return lhs.size() == rhs.size() && (lhs.data() == rhs.data() || memcmp(lhs.data(), rhs.data(), lhs.size()) == 0);
+}
+inline bool operator!= (StringView lhs, StringView rhs) noexcept {
+    return !(lhs == rhs);
+}
+inline bool operator< (StringView lhs, StringView rhs) noexcept {
+    return lhs.compare(rhs) < 0;
+}
+
+inline std::ostream& operator<< (std::ostream& os, StringView str) {
+    return os.write(str.data(), str.size());
+}
+
+}   // namespace json
+
+#endif
@@ -0,0 +1,75 @@
+#include "writer.h"
+#include <algorithm>
+#include <cerrno>
+#include <ostream>
+#include <unistd.h>
+#include "jsonException.h"
+using namespace std;
+
+namespace json {
+
+void Writer::writeSlow(const char* str, size_t n) {
+    // the buffer may be smaller than str, fill it as many times as needed
+    while (n) {
+        if (__cur == __end) overflow(1);
+        size_t len = min(n, static_cast<size_t>(__end - __cur));
+        memcpy(__cur, str, len);
+        __cur += len;
+        str += len;
+        n -= len;
+    }
+}
+
+void StringWriter::flush() {
+    size_t used = cur() - &__out[0];
+    __out.resize(used);
+    setBuffer(&__out[0] + used, &__out[0] + used);
+}
+
+void StringWriter::overflow(size_t n) {
+    // no buffer yet (called by the ctor): the string is all used
+    size_t used = cur() ? cur() - &__out[0] : __out.size();
+    // the whole capacity is the buffer, doubling it when it fills up
+    __out.resize(max(max(__out.capacity(), 2 * used), used + max<size_t>(n, 64)));
+    setBuffer(&__out[0] + used, &__out[0] + __out.size());
+}
+
+constexpr size_t ChunkWriter::kDefaultChunkSize;
+
+ChunkWriter::ChunkWriter(size_t chunkSize)
+    : __owned(new char[max<size_t>(chunkSize, 64)]), __chunk(__owned.get()), __chunkSize(max<size_t>(chunkSize, 64)) {
+    setBuffer(__chunk, __chunk + __chunkSize);
+}
+
+ChunkWriter::ChunkWriter(char* buffer, size_t size) noexcept : __chunk(buffer), __chunkSize(size) {
+    setBuffer(__chunk, __chunk + __chunkSize);
+}
+
+void ChunkWriter::flush() {
+    // reset the buffer first, so a throwing emit() does not emit the chunk twice
+    size_t n = cur() - __chunk;
+    setBuffer(__chunk, __chunk + __chunkSize);
+    if (n) emit(__chunk, n);
+}
+
+void ChunkWriter::overflow(size_t) {
+    flush();
+}
+
+void OstreamWriter::emit(const char* data, size_t n) {
+    __os.write(data, n);
+}
+
+void FdWriter::emit(const char* data, size_t n) {
+    while (n) {
+        ssize_t written = ::write(__fd, data, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throwException(JsonException(string("write failed: ") + strerror(errno)));
+        }
+        data += written;
+        n -= written;
+    }
+}
+
+}   // namespace json
@@ -0,0 +1,135 @@
+#ifndef _WRITER_H_
+#define _WRITER_H_
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include "stringView.h"
+#include "uncopyable.h"
+
+namespace json {
+
+// destination of serialized json.
+// chars are written into a buffer provided by the subclass, which is asked
+// to make room (grow it, or hand its content on) only when it is full.
+class Writer : uncopyable {
+public:
+    virtual ~Writer() = default;
+
+    void put(char ch) {
+        if (__cur == __end) overflow(1);
+        *__cur++ = ch;
+    }
+    void write(const char* str, std::size_t n) {
+        if (static_cast<std::size_t>(__end - __cur) >= n) {
+            memcpy(__cur, str, n);
+            __cur += n;
+        } else writeSlow(str, n);
+    }
+    void write(StringView str) { write(str.data(), str.size()); }
+
+    // make everything written so far visible at the destination
+    virtual void flush() {}
+
+protected:
+    Writer() noexcept : __cur(nullptr), __end(nullptr) {}
+    void setBuffer(char* begin, char* end) noexcept {
+        __cur = begin;
+        __end = end;
+    }
+    char* cur() const noexcept { return __cur; }
+
+    // called when the buffer has less than n free chars,
+    // must call setBuffer() with at least n of them
+    virtual void overflow(std::size_t n) = 0;
+
+private:
+    void writeSlow(const char* str, std::size_t n);
+
+    char* __cur;
+    char* __end;
+};
+
+// appends to a std::string, using its spare capacity as the buffer.
+// the string has its final size after flush() or the dtor.
+class StringWriter final : public Writer {
+public:
+    explicit StringWriter(std::string& out) : __out(out) { overflow(0); }
+    ~StringWriter() { flush(); }
+    void flush() override;
+
+private:
+    void overflow(std::size_t n) override;
+
+    std::string& __out;
+};
+
+// hands its content on in chunks of at most chunkSize chars, so memory
+// stays bounded whatever the size of the document.
+// the dtor does not flush: call flush() to emit the last chunk.
+class ChunkWriter : public Writer {
+public:
+    static constexpr std::size_t kDefaultChunkSize = 16384;
+
+    void flush() override;
+
+protected:
+    // chunkSize is at least 64
+    explicit ChunkWriter(std::size_t chunkSize = kDefaultChunkSize);
+    // chunks of size chars, written into buffer: nothing is allocated.
+    // buffer must outlive the writer
+    ChunkWriter(char* buffer, std::size_t size) noexcept;
+    virtual void emit(const char* data, std::size_t n) = 0;
+
+private:
+    void overflow(std::size_t n) override;
+
+    std::unique_ptr<char[]> __owned;    // the chunk, unless it was given
+    char* __chunk;
+    std::size_t __chunkSize;
+};
+
+// writes to an ostream, whose state reports any error
+class OstreamWriter final : public ChunkWriter {
+public:
+    explicit OstreamWriter(std::ostream& os, std::size_t chunkSize = kDefaultChunkSize)
+        : ChunkWriter(chunkSize), __os(os) {}
+    OstreamWriter(std::ostream& os, char* buffer, std::size_t size) noexcept
+        : ChunkWriter(buffer, size), __os(os) {}
+
+private:
+    void emit(const char* data, std::size_t n) override;
+
+    std::ostream& __os;
+};
+
+// writes to a POSIX file descriptor, throws JsonException if write(2) fails
+class FdWriter final : public ChunkWriter {
+public:
+    explicit FdWriter(int fd, std::size_t chunkSize = kDefaultChunkSize) : ChunkWriter(chunkSize), __fd(fd) {}
+
+private:
+    void emit(const char* data, std::size_t n) override;
+
+    int __fd;
+};
+
+// hands each chunk to a callback
+class CallbackWriter final : public ChunkWriter {
+public:
+    using callback_t = std::function<void(const char* data, std::size_t n)>;
+    explicit CallbackWriter(callback_t callback, std::size_t chunkSize = kDefaultChunkSize)
+        : ChunkWriter(chunkSize), __callback(std::move(callback)) {}
+
+private:
+    void emit(const char* data, std::size_t n) override { __callback(data, n); }
+
+    callback_t __callback;
+};
+
+}   // namespace json
+
+#endif
@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include "document.h"
+#include "json.h"
+#include "lazy.h"
+#include "jsonValue.h"
+#include "keyPool.h"
+#include "ndjson.h"
+#include "parse.h"
+#include "path.h"
+#include "pushParser.h"
+#include "scan.h"
+using namespace std;
+using namespace json;
+
+// count every heap allocation made by the program
+static size_t allocCount = 0;
+
+void* operator new(size_t size) {
+  ++allocCount;
+  if (void* p = malloc(size)) return p;
+  throwException(bad_alloc());
+}
+// not inlined, so the compiler does not see free() paired with operator new
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+struct Result {
+  double ms;
+  size_t allocs;
+};
+
+template <typename F>
+Result measure(int rounds, F&& f) {
+  size_t allocs = allocCount;
+  auto start = chrono::steady_clock::now();
+  for (int i = 0; i < rounds; ++i) f();
+  auto stop = chrono::steady_clock::now();
+  return {chrono::duration<double, milli>(stop - start).count() / rounds, (allocCount - allocs) / rounds};
+}
+
+void report(const char* name, const Result& r, size_t n) {
+  printf("  %-32s %10.3f ms %12zu allocs %8.3f allocs/elem\n", name, r.ms, r.allocs, 1.0 * r.allocs / n);
+}
+
+// telemetry-like document: one big array of numbers
+string numberArray(size_t n) {
+  string s = "[";
+  for (size_t i = 0; i < n; ++i) {
+    if (i) s += ",";
+    s += to_string(i * 0.25);
+  }
+  return s + "]";
+}
+
+// request-like document: an array of small records
+string recordArray(size_t n) {
+  string s = "[";
+  for (size_t i = 0; i < n; ++i) {
+    if (i) s += ",";
+    s += "{\"id\":" + to_string(i) + ",\"name\":\"user-" + to_string(i) +
+         "\",\"tags\":[\"a\",\"b\"],\"url\":\"https://example.com/some/long/path/" + to_string(i) + "\"}";
+  }
+  return s + "]";
+}
+
+// document of long ascii strings (urls, user agents, base64 blobs)
+string stringArray(size_t n) {
+  string s = "[";
+  for (size_t i = 0; i < n; ++i) {
+    if (i) s += ",";
+    s += "\"Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/" + to_string(i) +
+         " Safari/537.36 aGVsbG8gd29ybGQgaGVsbG8gd29ybGQgaGVsbG8gd29ybGQ=\"";
+  }
+  return s + "]";
+}
+
+// nested records, either minified or pretty printed with deep indentation
+string nestedRecords(size_t n, bool indent) {
+  string nl = indent ? "\n" : "";
+  auto pad = [indent](int depth) { return indent ? string(depth * 4, ' ') : string(); };
+  string s = "[" + nl;
+  for (size_t i = 0; i < n; ++i) {
+    s += pad(1) + "{" + nl;
+    s += pad(2) + "\"id\": " + to_string(i) + "," + nl;
+    s += pad(2) + "\"meta\": {" + nl;
+    s += pad(3) + "\"tags\": [" + nl + pad(4) + "\"a\"," + nl + pad(4) + "\"b\"" + nl + pad(3) + "]," + nl;
+    s += pad(3) + "\"geo\": {" + nl + pad(4) + "\"lat\": 1.5," + nl + pad(4) + "\"lon\": -2.25" + nl + pad(3) + "}" + nl;
+    s += pad(2) + "}" + nl;
+    s += pad(1) + "}" + (i + 1 < n ? "," : "") + nl;
+  }
+  return s + "]";
+}
+
+volatile double sink;
+
+void benchNodes(size_t n, int rounds) {
+  printf("build and read %zu number nodes\n", n);
+  Result boxed = measure(rounds, [n] {
+    vector<unique_ptr<JsonValue>> arr;
+    arr.reserve(n);
+    for (size_t i = 0; i < n; ++i) arr.push_back(make_unique<JsonDouble>(i * 0.25));
+    double sum = 0;
+    for (auto& e : arr) sum += e->toDouble();
+    sink = sum;
+  });
+  Result inplace = measure(rounds, [n] {
+    Json::array_t arr;
+    arr.reserve(n);
+    for (size_t i = 0; i < n; ++i) arr.push_back(Json(i * 0.25));
+    double sum = 0;
+    for (auto& e : arr) sum += e.toDouble();
+    sink = sum;
+  });
+  report("Value<T,U> (unique_ptr)", boxed, n);
+  report("Json (tagged union)", inplace, n);
+}
+
+void benchParse(size_t n, int rounds) {
+  string doc = numberArray(n);
+  printf("parse and sum %zu-element number array (%zu bytes)\n", n, doc.size());
+  Result r = measure(rounds, [&doc] {
+    string errmsg;
+    Json json = Json::parse(doc, errmsg);
+    double sum = 0;
+    for (auto& e : json.toArray()) sum += e.toDouble();
+    sink = sum;
+  });
+  report("Json::parse", r, n);
+  printf("  %-32s %10.1f MB/s\n", "", doc.size() / r.ms / 1000);
+}
+
+void benchSerialize(size_t n, int rounds) {
+  printf("serialize %zu-element number arrays\n", n);
+  Json::array_t ints, doubles;
+  for (size_t i = 0; i < n; ++i) {
+    ints.push_back(Json(static_cast<unsigned long long>(i * 2654435761ULL)));
+    doubles.push_back(Json(i * 0.1));
+  }
+  Json intArray(ints), doubleArray(doubles);
+  Result r = measure(rounds, [&intArray] { sink = intArray.serialize().size(); });
+  report("integers", r, n);
+  r = measure(rounds, [&doubleArray] { sink = doubleArray.serialize().size(); });
+  report("doubles", r, n);
+  printf("  %-32s %10zu bytes\n", "", doubleArray.serialize().size());
+  string errmsg;
+  Json records = Json::parse(nestedRecords(n / 10, false), errmsg);
+  r = measure(rounds, [&records] { sink = records.serialize().size(); });
+  report("nested records", r, n / 10);
+  string out;
+  r = measure(rounds, [&records, &out] {
+    out.clear();
+    records.serialize(out);
+    sink = out.size();
+  });
+  report("nested records, reused string", r, n / 10);
+  FILE* devnull = fopen("/dev/null", "w");
+  r = measure(rounds, [&records, devnull] {
+    FdWriter writer(fileno(devnull));
+    records.serialize(writer);
+    writer.flush();
+  });
+  fclose(devnull);
+  report("nested records, to /dev/null", r, n / 10);
+}
+
+void benchArena(size_t n, int rounds) {
+  string doc = recordArray(n);
+  printf("parse %zu records (%zu bytes), heap vs arena\n", n, doc.size());
+  Result heap = measure(rounds, [&doc] {
+    string errmsg;
+    Json json = Json::parse(doc, errmsg);
+    sink = json.size();
+  });
+  Result arena = measure(rounds, [&doc] {
+    string errmsg;
+    Document document;
+    document.parse(doc, errmsg);
+    sink = document.root().size();
+  });
+  // in-situ parsing overwrites its input, so every round works on a fresh copy
+  vector<string> copies(rounds, doc);
+  size_t round = 0;
+  Result insitu = measure(rounds, [&copies, &round] {
+    string errmsg;
+    Document document;
+    string& buf = copies[round++];
+    document.parseInsitu(&buf[0], buf.size(), errmsg);
+    sink = document.root().size();
+  });
+  KeyPool keys;
+  Result interned = measure(rounds, [&doc, &keys] {
+    string errmsg;
+    Json json = Json::parse(doc, errmsg, keys);
+    sink = json.size();
+  });
+  // the values outlive the arena: short strings and keys are copied inline
+  string errmsg;
+  Document parsed;
+  parsed.parse(doc, errmsg);
+  Result copied = measure(rounds, [&parsed] {
+    Json json = parsed.root();
+    sink = json.size();
+  });
+  report("Json::parse", heap, n);
+  report("Json::parse, KeyPool", interned, n);
+  report("Document::parse", arena, n);
+  report("Document::parseInsitu", insitu, n);
+  report("Document::root() copied", copied, n);
+}
+
+// sums the "id" members of the records
+struct IdSum : SaxHandler<IdSum> {
+  double sum = 0;
+  bool isId = false;
+  void onKey(StringView key) { isId = key == "id"; }
+  void onDouble(double val) {
+    if (isId) sum += val;
+  }
+};
+
+void benchSax(size_t n, int rounds) {
+  string doc = recordArray(n);
+  printf("sum the ids of %zu records (%zu bytes), DOM vs SAX\n", n, doc.size());
+  Result dom = measure(rounds, [&doc] {
+    Document document;
+    string errmsg;
+    document.parse(doc, errmsg);
+    double sum = 0;
+    for (auto& e : document.root().toArray()) sum += e["id"].toDouble();
+    sink = sum;
+  });
+  Result sax = measure(rounds, [&doc] {
+    IdSum handler;
+    Parser(doc).parse(handler);
+    sink = handler.sum;
+  });
+  report("Document::parse", dom, n);
+  report("Parser::parse(handler)", sax, n);
+}
+
+void benchPush(size_t n, int rounds) {
+  string doc = recordArray(n);
+  printf("parse %zu records (%zu bytes) at once vs in 4KB chunks\n", n, doc.size());
+  Result whole = measure(rounds, [&doc] {
+    string errmsg;
+    sink = Json::parse(doc, errmsg).size();
+  });
+  Result chunks = measure(rounds, [&doc] {
+    DomBuilder builder;
+    PushParser<DomBuilder> parser(builder);
+    for (size_t i = 0; i < doc.size(); i += 4096) parser.feed(StringView(doc.data() + i, min<size_t>(4096, doc.size() - i)));
+    parser.finish();
+    sink = builder.root().size();
+  });
+  report("Json::parse", whole, n);
+  report("PushParser<DomBuilder>", chunks, n);
+}
+
+void benchNdjson(size_t n, int rounds) {
+  string doc;
+  for (size_t i = 0; i < n; ++i)
+    doc += "{\"id\":" + to_string(i) + ",\"level\":\"info\",\"msg\":\"request served\",\"latency\":" +
+           to_string(i * 0.01) + ",\"tags\":[\"a\",\"b\"]}\n";
+  printf("read %zu ndjson records (%zu bytes)\n", n, doc.size());
+  for (unsigned threads : {1u, 0u}) {
+    NdjsonReader reader(threads);
+    for (bool ordered : {true, false}) {
+      Result r = measure(rounds, [&doc, &reader, ordered] {
+        atomic<size_t> count(0);
+        reader.read(doc, [&count](NdjsonRecord&) { ++count; }, ordered);
+        sink = count;
+      });
+      char name[64];
+      snprintf(name, sizeof(name), "%u threads, %s", reader.threads(), ordered ? "ordered" : "unordered");
+      printf("  %-32s %10.3f ms %10.1f MB/s\n", name, r.ms, doc.size() / r.ms / 1000);
+    }
+  }
+}
+
+void benchParallel(size_t n, int rounds) {
+  string doc = "[";
+  for (size_t i = 0; i < n; ++i)
+    doc += string(i ? "," : "") + "{\"id\":" + to_string(i) + ",\"level\":\"info\",\"msg\":\"request served\",\"latency\":" +
+           to_string(i * 0.01) + ",\"tags\":[\"a\",\"b\"]}";
+  doc += "]";
+  printf("parse an array of %zu records (%zu bytes)\n", n, doc.size());
+  Result serial = measure(rounds, [&doc] {
+    string errmsg;
+    sink = Json::parse(doc, errmsg).size();
+  });
+  printf("  %-32s %10.3f ms %10.1f MB/s\n", "serial", serial.ms, doc.size() / serial.ms / 1000);
+  unsigned threads = max(1u, thread::hardware_concurrency());
+  Result r = measure(rounds, [&doc, threads] {
+    string errmsg;
+    sink = Json::parseParallel(doc, errmsg, threads).size();
+  });
+  char name[64];
+  snprintf(name, sizeof(name), "%u threads", threads);
+  printf("  %-32s %10.3f ms %10.1f MB/s\n", name, r.ms, doc.size() / r.ms / 1000);
+}
+
+void benchLazy(size_t n, int rounds) {
+  // a large body read for a single field
+  string doc = "{\"data\":[";
+  for (size_t i = 0; i < n; ++i)
+    doc += string(i ? "," : "") + "{\"id\":" + to_string(i) + ",\"msg\":\"request served\",\"tags\":[\"a\",\"b\"]}";
+  doc += "],\"meta\":{\"id\":7}}";
+  printf("read one field of %zu bytes\n", doc.size());
+  Result full = measure(rounds, [&doc] {
+    string errmsg;
+    sink = Json::parse(doc, errmsg)["meta"]["id"].toInt64();
+  });
+  printf("  %-32s %10.3f ms %10.1f MB/s\n", "Json::parse", full.ms, doc.size() / full.ms / 1000);
+  Result lazy = measure(rounds, [&doc] {
+    LazyDocument document(doc);
+    sink = document.root()["meta"]["id"].get().toInt64();
+  });
+  printf("  %-32s %10.3f ms %10.1f MB/s\n", "LazyDocument", lazy.ms, doc.size() / lazy.ms / 1000);
+}
+
+void benchPath(size_t n, int rounds) {
+  string errmsg;
+  Json doc = Json::parse(R"({"meta": {"id": 7, "tags": ["a", "b"]}, "data": {"user": {"name": "x"}}})", errmsg);
+  printf("look up 2 paths %zu times\n", n);
+  Result chained = measure(rounds, [&doc, n] {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+      count += doc["meta"]["tags"][1].size() + doc["data"]["user"]["name"].size();
+    sink = count;
+  });
+  printf("  %-32s %10.3f ms\n", "operator[]", chained.ms);
+  JsonPointer tag("/meta/tags/1"), name("/data/user/name");
+  Result pointer = measure(rounds, [&] {
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+      count += tag.find(doc)->size() + name.find(doc)->size();
+    sink = count;
+  });
+  printf("  %-32s %10.3f ms\n", "JsonPointer", pointer.ms);
+}
+
+void benchFilter(size_t n, int rounds) {
+  // events of 300 fields, of which 5 are wanted
+  vector<string> events;
+  size_t bytes = 0;
+  for (size_t i = 0; i < n; ++i) {
+    string doc = "{";
+    for (int f = 0; f < 300; ++f)
+      doc += (f ? ",\"field" : "\"field") + to_string(f) + "\":" + (f % 3 ? "\"value " + to_string(i) + "\"" : to_string(f * 1.5));
+    events.push_back(doc + "}");
+    bytes += events.back().size();
+  }
+  printf("extract 5 fields of %zu events (%zu bytes)\n", n, bytes);
+  Result full = measure(rounds, [&events] {
+    size_t count = 0;
+    for (const string& doc : events) {
+      string errmsg;
+      count += Json::parse(doc, errmsg).size();
+    }
+    sink = count;
+  });
+  printf("  %-32s %10.3f ms %10.1f MB/s\n", "Json::parse", full.ms, bytes / full.ms / 1000);
+  PathFilter filter({JsonPointer("/field0"), JsonPointer("/field7"), JsonPointer("/field42"),
+                     JsonPointer("/field150"), JsonPointer("/field299")});
+  Result filtered = measure(rounds, [&events, &filter] {
+    size_t count = 0;
+    for (const string& doc : events) {
+      string errmsg;
+      count += filter.parse(doc, errmsg).size();
+    }
+    sink = count;
+  });
+  printf("  %-32s %10.3f ms %10.1f MB/s\n", "PathFilter", filtered.ms, bytes / filtered.ms / 1000);
+}
+
+void benchCopy(size_t n, int rounds) {
+  // a config document handed to many workers
+  string text = "{\"routes\":[";
+  for (size_t i = 0; i < n; ++i)
+    text += string(i ? "," : "") + "{\"path\":\"/api/v1/resource/" + to_string(i) + "\",\"timeout\":" + to_string(i % 30) + "}";
+  text += "],\"name\":\"service\"}";
+  string errmsg;
+  Json doc = Json::parse(text, errmsg);
+  printf("copy a document of %zu routes 64 times\n", n);
+  Result copy = measure(rounds, [&doc] {
+    vector<Json> workers(64, doc);
+    sink = workers.size();
+  });
+  report("copy", copy, 64);
+  Result write = measure(rounds, [&doc] {
+    vector<Json> workers(64, doc);
+    for (Json& json : workers) json["name"] = Json("worker");
+    sink = workers.size();
+  });
+  report("copy, write a member", write, 64);
+  Result deep = measure(rounds, [&text] {
+    for (int i = 0; i < 64; ++i) {
+      string errmsg;
+      sink = Json::parse(text, errmsg).size();
+    }
+  });
+  report("parse again", deep, 64);
+}
+
+void benchErrors(size_t n, int rounds) {
+  // a large body rejected near its start
+  string doc = "[tru" + recordArray(n);
+  printf("reject %zu bytes at offset 1\n", doc.size());
+  Result message = measure(rounds, [&doc] {
+    string errmsg;
+    Json::parse(doc, errmsg);
+    sink = errmsg.size();
+  });
+  Result error = measure(rounds, [&doc] {
+    ParseError error;
+    Json::parse(doc, error);
+    sink = error.offset;
+  });
+  report("Json::parse, errmsg", message, 1);
+  report("Json::parse, ParseError", error, 1);
+
+  // a flood of small invalid bodies
+  vector<string> bodies;
+  for (int i = 0; i < 1000; ++i) bodies.push_back("{\"id\": " + to_string(i) + ", \"tags\": [\"a\", \"b\"], \"ok\": tru}");
+  printf("reject %zu small bodies\n", bodies.size());
+  Result flood = measure(rounds, [&bodies] {
+    for (const string& body : bodies) {
+      string errmsg;
+      Json::parse(body, errmsg);
+      sink = errmsg.size();
+    }
+  });
+  report("Json::parse, errmsg", flood, bodies.size());
+}
+
+void benchValidate(size_t n, int rounds) {
+  // a gateway checking bodies before routing them, without needing the tree
+  string doc = recordArray(n);
+  printf("validate %zu records (%zu bytes)\n", n, doc.size());
+  Result parse = measure(rounds, [&doc] {
+    Document document;
+    ParseError error;
+    sink = document.parse(doc, error);
+  });
+  Result sax = measure(rounds, [&doc] {
+    struct Ignore final : SaxHandler<Ignore> {} ignore;
+    ParseError error;
+    sink = Parser(doc).parse(ignore, error);
+  });
+  Result validate = measure(rounds, [&doc] {
+    ParseError error;
+    sink = Json::validate(doc, error);
+  });
+  report("Document::parse", parse, n);
+  report("Parser::parse(no-op handler)", sax, n);
+  report("Json::validate", validate, n);
+}
+
+void benchStrings(size_t n, int rounds) {
+  string doc = stringArray(n);
+  printf("parse %zu long strings (%zu bytes)\n", n, doc.size());
+  const char* names[] = {"scalar", "SSE2", "AVX2"};
+  SimdLevel best = detectSimdLevel();
+  for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2}) {
+    if (level > best) break;
+    setSimdLevel(level);
+    Result r = measure(rounds, [&doc] {
+      string errmsg;
+      Document document;
+      document.parse(doc, errmsg);
+      sink = document.root().size();
+    });
+    printf("  %-32s %10.3f ms %10.1f MB/s\n", names[static_cast<int>(level)], r.ms, doc.size() / r.ms / 1000);
+  }
+  setSimdLevel(best);
+}
+
+void benchWhitespace(size_t n, int rounds) {
+  const char* names[] = {"scalar", "SSE2", "AVX2"};
+  SimdLevel best = detectSimdLevel();
+  for (bool indent : {false, true}) {
+    string doc = nestedRecords(n, indent);
+    printf("%s records (%zu bytes)\n", indent ? "indented" : "minified", doc.size());
+    for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2}) {
+      if (level > best) break;
+      setSimdLevel(level);
+      Result parse = measure(rounds, [&doc] {
+        string errmsg;
+        Document document;
+        document.parse(doc, errmsg);
+        sink = document.root().size();
+      });
+      vector<uint32_t> index;
+      Result scan = measure(rounds, [&doc, &index] {
+        structuralIndex(doc.data(), doc.data() + doc.size(), index);
+        sink = index.size();
+      });
+      printf("  %-8s parse %10.1f MB/s   structural index %10.1f MB/s\n", names[static_cast<int>(level)],
+             doc.size() / parse.ms / 1000, doc.size() / scan.ms / 1000);
+    }
+  }
+  setSimdLevel(best);
+}
+
+int main(int argc, char* argv[]) {
+  size_t n = argc > 1 ? strtoul(argv[1], nullptr, 10) : 100000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 20;
+  benchNodes(n, rounds);
+  benchParse(n, rounds);
+  benchSerialize(n, rounds);
+  benchArena(n / 10, rounds);
+  benchSax(n / 10, rounds);
+  benchPush(n / 10, rounds);
+  benchNdjson(n, rounds);
+  benchParallel(n, rounds);
+  benchLazy(n / 4, rounds);
+  benchPath(n * 10, rounds);
+  benchFilter(n / 100, rounds);
+  benchCopy(n / 10, rounds);
+  benchErrors(n / 10, rounds);
+  benchValidate(n / 10, rounds);
+  benchStrings(n / 10, rounds);
+  benchWhitespace(n / 10, rounds);
+}
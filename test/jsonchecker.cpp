@@ -1,4 +1,5 @@
 #include "json.h"
+#include "jsonException.h"
 #include <dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -11,9 +12,22 @@
 using namespace std;
 using namespace json;
 
+// --validate: check the files with Json::validate() instead of parsing them
+bool validateOnly = false;
+
+bool isValid(const string& jsonStr) {
+  if (validateOnly) {
+    ParseError error;
+    return Json::validate(jsonStr, error);
+  }
+  string errMsg;
+  Json json_ = Json::parse(jsonStr, errMsg);
+  return errMsg == "";
+}
+
 string getJsonStr(const string& filename) {
   ifstream ifstrm(filename);
-  if (!ifstrm.is_open()) throw runtime_error("can't open " + string(filename));
+  if (!ifstrm.is_open()) throwException(runtime_error("can't open " + string(filename)));
   string jsonStr;
   while (ifstrm) {
     string line;
@@ -25,9 +39,7 @@ string getJsonStr(const string& filename) {
 
 void failJson(const string& filename) {
   string jsonStr = getJsonStr(filename);
-  string errMsg;
-  Json json_ = Json::parse(jsonStr, errMsg);
-  if (errMsg == "") {
+  if (isValid(jsonStr)) {
     cerr << "ERROR! expect fail, but pass" << endl;
     cerr << "file: " << filename << endl;
     cerr << jsonStr << endl;
@@ -37,9 +49,7 @@ void failJson(const string& filename) {
 
 void passJson(const string& filename) {
   string jsonStr = getJsonStr(filename);
-  string errMsg;
-  Json json_ = Json::parse(jsonStr, errMsg);
-  if (errMsg != "") {
+  if (!isValid(jsonStr)) {
     cerr << "ERROR! expect pass, but fail" << endl;
     cerr << "file: " << filename << endl;
     cerr << jsonStr << endl;
@@ -47,7 +57,14 @@ void passJson(const string& filename) {
   }
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--validate") == 0) validateOnly = true;
+    else {
+      cerr << "usage: " << argv[0] << " [--validate]" << endl;
+      return 1;
+    }
+  }
   struct stat stat;
   if (lstat(".", &stat) < 0) {
     cerr << "lstat error" << endl;
@@ -1,9 +1,46 @@
 #include <gtest/gtest.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unistd.h>
+#include "document.h"
 #include "json.h"
+#include "jsonException.h"
+#include "keyPool.h"
+#include "lazy.h"
+#include "ndjson.h"
+#include "parallel.h"
+#include "parse.h"
+#include "path.h"
+#include "pushParser.h"
+#include "scan.h"
 using namespace json;
 using namespace std;
 
+// count every heap allocation made by the program
+static atomic<size_t> allocCount(0);
+// allocations of the current thread to let through before one fails, -1 for none
+static thread_local long allocsBeforeFailure = -1;
+
+void* operator new(size_t size) {
+  ++allocCount;
+  if (allocsBeforeFailure >= 0 && allocsBeforeFailure-- == 0) throw bad_alloc();
+  if (void* p = malloc(size)) return p;
+  throw bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+// not inlined, so the compiler does not see free() paired with operator new
+__attribute__((noinline)) void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+void operator delete[](void* p) noexcept { operator delete(p); }
+void operator delete[](void* p, size_t) noexcept { operator delete(p); }
+
 Json parseOk(const string& strJson) {
   string errMsg;
   Json json = Json::parse(strJson, errMsg);
@@ -106,6 +143,58 @@ TEST(Str2Json, JsonNumber) {
   EXPECT_EQ(3.1415, json.toDouble());
 }
 
+TEST(Str2Json, NumberRounding) {
+  // halfway between two doubles: ties to even
+  testNumber(9007199254740992.0, "9007199254740993");
+  testNumber(9007199254740996.0, "9007199254740995");
+  testNumber(0.1, "0.1");
+  testNumber(0.30000000000000004, "0.30000000000000004");
+  testNumber(1e23, "1e23");
+  testNumber(-0.0, "-0");
+  testNumber(1e-5, "0.00001");
+  // more digits than fit in 64 bits
+  testNumber(1.2345678901234568e29, "123456789012345678901234567890");
+  testNumber(9007199254740994.0, "9007199254740993.000000000000000000001");
+  testNumber(2.4703282292062328e-324, "2.4703282292062328e-324");
+  testNumber(1e-300, "0.000000000000000000000000000000000000000000001e-255");
+  testNumber(1e30, "1000000000000000000000000000000000000000000e-12");
+  testError("NUMBER TOO BIG", "1.7976931348623159e308");
+  testError("NUMBER TOO BIG", "100000000000000000000000000000000000000000e300");
+}
+
+TEST(Str2Json, Integer) {
+  string errmsg;
+  // ids above 2^53 must survive exactly
+  Json json = Json::parse("1234567890123456789", errmsg);
+  EXPECT_TRUE(json.isInteger());
+  EXPECT_EQ(1234567890123456789LL, json.toInt64());
+  EXPECT_EQ("1234567890123456789", json.serialize());
+  json = Json::parse("18446744073709551615", errmsg);
+  EXPECT_EQ(UINT64_MAX, json.toUint64());
+  EXPECT_THROW(json.toInt64(), JsonException);
+  EXPECT_EQ("18446744073709551615", json.serialize());
+  json = Json::parse("-9223372036854775808", errmsg);
+  EXPECT_EQ(INT64_MIN, json.toInt64());
+  EXPECT_EQ("-9223372036854775808", json.serialize());
+  EXPECT_THROW(json.toUint64(), JsonException);
+  // out of range integers, fractions and exponents stay doubles
+  json = Json::parse("18446744073709551616", errmsg);
+  EXPECT_FALSE(json.isInteger());
+  EXPECT_DOUBLE_EQ(18446744073709551616.0, json.toDouble());
+  EXPECT_FALSE(Json::parse("-9223372036854775809", errmsg).isInteger());
+  EXPECT_FALSE(Json::parse("1.0", errmsg).isInteger());
+  EXPECT_FALSE(Json::parse("1e2", errmsg).isInteger());
+  EXPECT_FALSE(Json::parse("-0", errmsg).isInteger());
+  // integral doubles convert, others do not
+  EXPECT_EQ(100, Json::parse("1e2", errmsg).toInt64());
+  EXPECT_THROW(Json(1.5).toInt64(), JsonException);
+  EXPECT_THROW(Json(-1).toUint64(), JsonException);
+  EXPECT_EQ(Json(123), Json(123.0));
+  EXPECT_EQ(Json(123), Json(123U));
+  EXPECT_NE(Json(-1), Json(UINT64_MAX));
+  EXPECT_EQ("-42", Json(-42).serialize());
+}
+
 TEST(Str2Json, JsonString) {
   testString("", "\"\"");
   testString("Hello", "\"Hello\"");
@@ -302,6 +391,55 @@ TEST(Error, MissCommaOrCurlyBracket) {
   testError("MISS COMMA OR CURLY BRACKET", "{\"a\":{}");
 }
 
+TEST(Error, Location) {
+  ParseError error;
+  EXPECT_FALSE(error);
+
+  Json json = Json::parse("{\n  \"a\": [1, 2],\n  \"b\" 3\n}", error);
+  EXPECT_TRUE(json.isNull());
+  EXPECT_TRUE(error);
+  EXPECT_EQ(ParseError::MISS_COLON, error.code);
+  EXPECT_EQ(23u, error.offset);
+  EXPECT_EQ(3u, error.line);
+  EXPECT_EQ(7u, error.column);
+  EXPECT_STREQ("3", error.context);
+  EXPECT_EQ("MISS COLON: line 3, column 7: 3", error.str());
+
+  // the message is the same, the context is bounded whatever the size of the input
+  string big = "[\"abc\", tru" + string(1 << 20, ' ') + "]";
+  string errmsg;
+  Json::parse(big, errmsg);
+  EXPECT_EQ("INVALID VALUE: line 1, column 12: " + string(ParseError::kContextSize, ' '), errmsg);
+  Document document;
+  EXPECT_FALSE(document.parse(big, error));
+  EXPECT_EQ(ParseError::INVALID_VALUE, error.code);
+  EXPECT_EQ(11u, error.offset);
+  EXPECT_EQ(ParseError::kContextSize, strlen(error.context));
+
+  // numbers are reported at their start, a NUL char ends the context
+  Json::parse(string("[1e400]\0x", 9), error);
+  EXPECT_EQ(ParseError::NUMBER_TOO_BIG, error.code);
+  EXPECT_EQ(1u, error.offset);
+  EXPECT_STREQ("1e400]", error.context);
+  Json::parse("", error);
+  EXPECT_EQ(ParseError::EXPECT_VALUE, error.code);
+  EXPECT_EQ(0u, error.offset);
+  EXPECT_EQ(1u, error.column);
+  EXPECT_STREQ("EXPECT VALUE", error.message());
+
+  // in-situ mode decodes the \n escape into a new line before the error,
+  // which does not move it to another line
+  string text = "[\"a\\nb\", \"x\\ty\" 1]";
+  string expected = "MISS COMMA OR SQUARE BRACKET: line 1, column 17: 1]";
+  Json::parse(text, errmsg);
+  EXPECT_EQ(expected, errmsg);
+  Json::parseInsitu(&text[0], text.size(), errmsg);
+  EXPECT_EQ(expected, errmsg);
+  text = "[\"a\\nb\",\n \"x\\ty\" 1]";
+  Json::parseInsitu(&text[0], text.size(), errmsg);
+  EXPECT_EQ("MISS COMMA OR SQUARE BRACKET: line 2, column 9: 1]", errmsg);
+}
+
 TEST(Json, Ctor) {
   {
     Json json(nullptr);
@@ -346,6 +484,1010 @@ TEST(Json, Ctor) {
   }
 }
 
+TEST(Json, TaggedUnion) {
+  Json json(1.5);
+  EXPECT_THROW(json.toBool(), JsonException);
+  EXPECT_THROW(json.toString(), JsonException);
+  EXPECT_THROW(json[0], JsonException);
+  EXPECT_EQ(json.size(), 0);
+
+  json = Json("str");
+  EXPECT_TRUE(json.isString());
+  EXPECT_THROW(json.toDouble(), JsonException);
+
+  Json moved(std::move(json));
+  EXPECT_EQ(moved.toString(), "str");
+  EXPECT_TRUE(json.isNull());
+
+  Json copy(moved);
+  EXPECT_EQ(copy, moved);
+  copy = Json(false);
+  EXPECT_EQ(moved.toString(), "str");
+  EXPECT_EQ(copy.toBool(), false);
+}
+
+TEST(Document, Arena) {
+  Json copy(nullptr);
+  {
+    Document doc;
+    string errMsg;
+    EXPECT_TRUE(doc.parse("{ \"s\" : \"abc\", \"a\" : [ 1, \"x\", { \"k\" : null } ] }", errMsg));
+    EXPECT_EQ(errMsg, "");
+    const Json& root = doc.root();
+    EXPECT_TRUE(root.isObject());
+    EXPECT_EQ(root["s"].toString(), "abc");
+    EXPECT_EQ(root["a"].size(), 3);
+    EXPECT_EQ(root["a"][1].toString(), "x");
+    EXPECT_TRUE(root["a"][2]["k"].isNull());
+    EXPECT_EQ(root, parseOk(root.serialize()));
+    EXPECT_EQ(doc.arena().pageCount(), 1);
+    copy = root["a"];
+
+    EXPECT_FALSE(doc.parse("[1, 2", errMsg));
+    EXPECT_EQ(errMsg.substr(0, errMsg.find(':')), "MISS COMMA OR SQUARE BRACKET");
+    EXPECT_TRUE(doc.root().isNull());
+  }
+  // copies are heap values and outlive the document
+  EXPECT_EQ(copy.size(), 3);
+  EXPECT_EQ(copy[1].toString(), "x");
+}
+
+TEST(Str2Json, Buffer) {
+  // not NUL-terminated, only the first size chars belong to the document
+  const char buf[] = {'[', '1', ',', '"', 'a', '"', ']', 'x'};
+  string errMsg;
+  Json json = Json::parse(StringView(buf, 7), errMsg);
+  EXPECT_EQ(errMsg, "");
+  EXPECT_EQ(json.size(), 2);
+  EXPECT_EQ(json[1].toString(), "a");
+  json = Json::parse(StringView(buf, 2), errMsg);
+  EXPECT_EQ(errMsg, "MISS COMMA OR SQUARE BRACKET: line 1, column 3: ");
+  testError("MISS QUOTATION MARK", StringView(buf + 3, 2));
+  testError("INVALID VALUE", StringView("tru", 3));
+}
+
+TEST(Str2Json, Insitu) {
+  char buf[] = "{ \"plain\" : \"abc\", \"esc\\n\" : [ \"a\\tb\\u20AC\\uD834\\uDD1E\" ] }";
+  string errMsg;
+  Json json = Json::parseInsitu(buf, sizeof(buf) - 1, errMsg);
+  EXPECT_EQ(errMsg, "");
+  StringView plain = json["plain"].toString();
+  EXPECT_EQ(plain, "abc");
+  EXPECT_TRUE(plain.data() > buf && plain.data() < buf + sizeof(buf));
+  StringView esc = json["esc\n"][0].toString();
+  EXPECT_EQ(esc, "a\tb\xE2\x82\xAC\xF0\x9D\x84\x9E");
+  EXPECT_TRUE(esc.data() > buf && esc.data() < buf + sizeof(buf));
+
+  Json copy = json;
+  memset(buf, 0, sizeof(buf));
+  EXPECT_EQ(copy["plain"].toString(), "abc");
+  EXPECT_EQ(copy["esc\n"][0].toString(), "a\tb\xE2\x82\xAC\xF0\x9D\x84\x9E");
+}
+
+TEST(Scan, String) {
+  SimdLevel best = detectSimdLevel();
+  for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2}) {
+    if (level > best) break;
+    setSimdLevel(level);
+    EXPECT_EQ(simdLevel(), level);
+    for (size_t len = 0; len < 80; ++len) {
+      for (char special : {'"', '\\', '\x01', '\x1f', '\0'}) {
+        string s(len, 'a');
+        if (len) s[len / 3] = '\x80';  // non-ascii bytes are plain
+        EXPECT_EQ(scanString(s.data(), s.data() + s.size()), s.data() + s.size());
+        s.push_back(special);
+        s += "tail";
+        EXPECT_EQ(scanString(s.data(), s.data() + s.size()), s.data() + len);
+      }
+    }
+    string plain(100, 'x');
+    testString(plain + "\n" + plain, "\"" + plain + "\\n" + plain + "\"");
+    testError("INVALID STRING CHAR", "\"" + plain + "\x01\"");
+    testError("MISS QUOTATION MARK", "\"" + plain);
+  }
+  setSimdLevel(best);
+}
+
+// reference structural index: one char at a time
+vector<uint32_t> naiveIndex(const string& s) {
+  vector<uint32_t> ret;
+  bool inString = false;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\\') {
+      ++i;  // escapes the next char, even outside a string (invalid json anyway)
+    } else if (inString) {
+      if (s[i] == '"') inString = false;
+    } else if (s[i] == '"') {
+      inString = true;
+      ret.push_back(i);
+    } else if (s[i] && strchr("{}[]:,", s[i])) {
+      ret.push_back(i);
+    }
+  }
+  return ret;
+}
+
+TEST(Scan, Structural) {
+  SimdLevel best = detectSimdLevel();
+  vector<string> texts = {"", "[]", "{ \"a\" : [ 1, 2, { } ], \"b\" : \"x,y\" }", "\"unterminated [",
+                          "[\"\\\\\", \"\\\"]\", \"\\\\\\\"{\"]"};
+  srand(42);
+  for (int i = 0; i < 200; ++i) {
+    string s;
+    size_t len = rand() % 300;
+    for (size_t j = 0; j < len; ++j) s.push_back("{}[]:,\"\\ a\n"[rand() % 12]);
+    texts.push_back(s);
+  }
+  for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2}) {
+    if (level > best) break;
+    setSimdLevel(level);
+    for (const string& s : texts) {
+      vector<uint32_t> index;
+      EXPECT_TRUE(structuralIndex(s.data(), s.data() + s.size(), index));
+      EXPECT_EQ(index, naiveIndex(s)) << s;
+    }
+    for (size_t len = 0; len < 80; ++len) {
+      string s = string(len, ' ') + "\t\r\n" + string(len, '\n') + "x";
+      EXPECT_EQ(skipWhitespace(s.data(), s.data() + s.size()), s.data() + s.size() - 1);
+      EXPECT_EQ(skipWhitespace(s.data(), s.data() + s.size() - 1), s.data() + s.size() - 1);
+    }
+    Json json = parseOk("\n\t\t\t\t[\n\t\t\t\t\t1 ,\r\n                                    2\n\t\t\t\t]\n\n");
+    EXPECT_EQ(json.size(), 2);
+  }
+  setSimdLevel(best);
+}
+
+// records the events as text
+struct Recorder : SaxHandler<Recorder> {
+  string events;
+  void onNull() { events += "null "; }
+  void onBool(bool val) { events += val ? "true " : "false "; }
+  void onDouble(double val) { events += "d:" + to_string(val) + " "; }
+  void onInt64(int64_t val) { events += "i:" + to_string(val) + " "; }
+  void onString(StringView str) { events += "s:" + str.str() + " "; }
+  void onStartObject() { events += "{ "; }
+  void onKey(StringView str) { events += "k:" + str.str() + " "; }
+  void onEndObject(size_t n) { events += "}" + to_string(n) + " "; }
+  void onStartArray() { events += "[ "; }
+  void onEndArray(size_t n) { events += "]" + to_string(n) + " "; }
+};
+
+TEST(Sax, Events) {
+  Recorder recorder;
+  Parser(R"( {"a": [1, -2, 1.5, 18446744073709551615, "x\ny"], "b": {}, "c": [null, true, false]} )").parse(recorder);
+  EXPECT_EQ("{ k:a [ i:1 i:-2 d:1.500000 d:18446744073709551616.000000 s:x\ny ]5 k:b { }0 k:c [ null true false ]3 }3 ",
+            recorder.events);
+
+  // handlers only see the events they hide
+  struct Sum : SaxHandler<Sum> {
+    double sum = 0;
+    void onDouble(double val) { sum += val; }
+  } sum;
+  Parser("[1, {\"a\": 2.5}, \"3\", [4]]").parse(sum);
+  EXPECT_EQ(7.5, sum.sum);
+
+  // in-situ: views into the buffer
+  char buf[] = R"(["a\tb"])";
+  recorder.events.clear();
+  Parser(buf, strlen(buf)).parse(recorder);
+  EXPECT_EQ("[ s:a\tb ]1 ", recorder.events);
+}
+
+TEST(Sax, Errors) {
+  // the same grammar and messages as the DOM parser
+  for (const char* text : {"", "nul", "[1,", "[1 2]", "{\"a\" 1}", "{1:1}", "{\"a\":1 ]", "\"abc", "\"\\x\"",
+                           "\"\\uD800\"", "01", "1e", "1e400", "[] x"}) {
+    string errmsg;
+    Json::parse(text, errmsg);
+    EXPECT_NE("", errmsg) << text;
+    Recorder recorder;
+    try {
+      Parser(text).parse(recorder);
+      ADD_FAILURE() << text;
+    } catch (JsonException& err) {
+      EXPECT_EQ(errmsg, err.what());
+    }
+  }
+}
+
+TEST(Push, Chunks) {
+  const string text = R"({"a": [1, -2.5e3, 18446744073709551615, "x\"\u00e9\ud83d\ude00y"], "key": {"t": true, "f": false, "n": null}} )";
+  Recorder expected;
+  Parser(text).parse(expected);
+  // cut anywhere: in strings, escapes, numbers, literals
+  for (size_t cut = 0; cut <= text.size(); ++cut) {
+    Recorder recorder;
+    PushParser<Recorder> parser(recorder);
+    parser.feed(StringView(text.data(), cut));
+    parser.feed(StringView(text.data() + cut, text.size() - cut));
+    parser.finish();
+    EXPECT_EQ(expected.events, recorder.events) << cut;
+  }
+  // one char at a time
+  Recorder recorder;
+  PushParser<Recorder> parser(recorder);
+  for (char ch : text) parser.feed(StringView(&ch, 1));
+  EXPECT_TRUE(parser.done());
+  parser.finish();
+  EXPECT_EQ(expected.events, recorder.events);
+
+  // building a Json
+  DomBuilder builder;
+  PushParser<DomBuilder> domParser(builder);
+  domParser.feed(StringView(text.data(), 20));
+  domParser.feed(StringView(text.data() + 20, text.size() - 20));
+  domParser.finish();
+  EXPECT_EQ(parseOk(text), builder.root());
+}
+
+TEST(Push, Errors) {
+  // the same errors as Parser, whether the input ends or goes on
+  for (const char* text : {"", "[1,", "[1 2]", "{\"a\"", "{\"a\":", "{", "\"abc", "\"\\", "\"\\u12", "\"\\uD800",
+                           "\"\\uD800\\u0041\"", "-", "1.", "1e+", "nul", "tru e", "1e400", "[] x", "{\"a\":1]"}) {
+    string errmsg;
+    Json::parse(text, errmsg);
+    string expected = errmsg.substr(0, errmsg.find(':'));
+    Recorder recorder;
+    PushParser<Recorder> parser(recorder);
+    try {
+      for (const char* p = text; *p; ++p) parser.feed(StringView(p, 1));
+      parser.finish();
+      ADD_FAILURE() << text;
+    } catch (JsonException& err) {
+      string what = err.what();
+      EXPECT_EQ(expected, what.substr(0, what.find(':'))) << text;
+      // at the same place, although the chunks are gone
+      ParseError error;
+      Json::parse(text, error);
+      EXPECT_EQ(error.code, parser.error().code) << text;
+      EXPECT_EQ(error.offset, parser.error().offset) << text;
+      EXPECT_EQ(error.column, parser.error().column) << text;
+    }
+  }
+}
+
+TEST(NoThrow, Parse) {
+  // the same errors as the throwing functions, returned instead
+  for (const char* text : {"", "nul", "[1,", "{\"a\" 1}", "\"\\uD800\"", "1e400", "[] x"}) {
+    string errmsg;
+    Json::parse(text, errmsg);
+    ParseError error;
+    Recorder recorder;
+    EXPECT_FALSE(Parser(text).parse(recorder, error)) << text;
+    EXPECT_EQ(errmsg, error.str());
+    ParseError pushed;
+    PushParser<Recorder> parser(recorder);
+    EXPECT_FALSE(parser.feed(text, pushed) && parser.finish(pushed)) << text;
+    EXPECT_EQ(error.code, pushed.code) << text;
+    EXPECT_EQ(error.offset, pushed.offset) << text;
+  }
+  // the events stop at the error
+  ParseError error;
+  Recorder recorder;
+  EXPECT_FALSE(Parser("[1, {\"a\": tru}, 2]").parse(recorder, error));
+  EXPECT_EQ("[ i:1 { k:a ", recorder.events);
+  EXPECT_EQ(ParseError::INVALID_VALUE, error.code);
+  // a later success clears the error
+  Parser parser("[1, x]");
+  EXPECT_TRUE(parser.parse(error).isNull());
+  EXPECT_TRUE(parser.error());
+  EXPECT_EQ(Json(true), Parser("true").parse(error));
+  EXPECT_TRUE(Document().parse("[1]", error));
+}
+
+TEST(NoThrow, Access) {
+  Json json = parseOk(R"({"b": true, "d": 1.5, "i": -3, "u": 18446744073709551615, "s": "str", "a": [1], "o": {}})");
+  bool b = false;
+  double d = 0;
+  int64_t i = 0;
+  uint64_t u = 0;
+  StringView s;
+  const Json::array_t* a = nullptr;
+  const Json::object_t* o = nullptr;
+  EXPECT_TRUE(json.find("b")->get(b) && b);
+  EXPECT_TRUE(json.find("d")->get(d) && d == 1.5);
+  EXPECT_TRUE(json.find("i")->get(i) && i == -3);
+  EXPECT_TRUE(json.find("i")->get(d) && d == -3);
+  EXPECT_TRUE(json.find("u")->get(u) && u == UINT64_MAX);
+  EXPECT_TRUE(json.find("s")->get(s) && s == "str");
+  EXPECT_TRUE(json.find("a")->get(a) && a->size() == 1);
+  EXPECT_TRUE(json.find("o")->get(o) && o->empty());
+  EXPECT_TRUE(json.get(o) && o->size() == 7);
+  EXPECT_EQ(1, json.find("a")->find(0)->toInt64());
+
+  // mismatches leave the value as it was
+  EXPECT_FALSE(json.find("s")->get(b));
+  EXPECT_FALSE(json.find("d")->get(i));
+  EXPECT_FALSE(json.find("i")->get(u));
+  EXPECT_FALSE(json.find("u")->get(i));
+  EXPECT_FALSE(json.find("b")->get(s));
+  EXPECT_FALSE(json.get(a));
+  EXPECT_EQ(-3, i);
+  EXPECT_EQ(UINT64_MAX, u);
+  EXPECT_EQ(nullptr, json.find("missing"));
+  EXPECT_EQ(nullptr, json.find(0));
+  EXPECT_EQ(nullptr, json.find("a")->find(1));
+  EXPECT_EQ(nullptr, json.find("s")->find("x"));
+}
+
+TEST(Validate, Errors) {
+  // the same result and errors as parse()
+  for (const char* text : {"null", " [1, 2.5e3, -0, \"a\\u00e9\\uD83D\\uDE00\"] ", "{\"k\": {\"k\": []}}",
+                           "", "nul", "[1,", "{\"a\" 1}", "{1:2}", "\"\\uD800\"", "\"\\x\"", "1e400", "01", "[] x"}) {
+    ParseError parsed, validated;
+    Json::parse(text, parsed);
+    EXPECT_EQ(!parsed, Json::validate(text, validated)) << text;
+    EXPECT_EQ(parsed.str(), validated.str()) << text;
+  }
+  // around the largest double, where only the slow path tells whether it overflows
+  for (const char* digits : {"17976931348623158079", "17976931348623158080"}) {
+    string text = digits + string(289, '0');
+    ParseError parsed, validated;
+    Json::parse(text, parsed);
+    EXPECT_EQ(!parsed, Json::validate(text, validated)) << digits;
+    EXPECT_EQ(parsed.code, validated.code) << digits;
+  }
+}
+
+TEST(Validate, UTF8) {
+  for (const char* text : {"\"\xC3\xA9\"", "\"\xE2\x82\xAC\"", "\"\xED\x9F\xBF\"", "\"\xEE\x80\x80\"",
+                           "\"\xF0\x9F\x98\x80\"", "\"\xF4\x8F\xBF\xBF\"", "{\"\xC3\xA9\": \"ab\xC3\xA9\\n\xC3\xA9" "cdefghi\"}"}) {
+    ParseError error;
+    EXPECT_TRUE(Json::validate(text, error)) << error.str();
+  }
+  // offset of the first byte that is not part of a valid sequence
+  const pair<const char*, size_t> invalid[] = {
+    {"\"\x80\"", 1},                 // lone continuation byte
+    {"\"\xC0\xAF\"", 1},            // overlong '/'
+    {"\"\xC1\xBF\"", 1},
+    {"\"\xE0\x9F\xBF\"", 1},       // overlong 3 bytes
+    {"\"\xF0\x8F\xBF\xBF\"", 1},  // overlong 4 bytes
+    {"\"\xED\xA0\x80\"", 1},       // surrogate
+    {"\"\xF4\x90\x80\x80\"", 1},  // above U+10FFFF
+    {"\"\xF5\x80\x80\x80\"", 1},
+    {"\"\xFF\"", 1},
+    {"\"\xE2\x82\"", 1},            // cut by the quote
+    {"\"\xE2\x82", 1},               // cut by the end
+    {"[\"abcdefghijklmnop\xC3\x28\"]", 18},
+    {"{\"k\xE9y\": 1}", 3},
+  };
+  for (const auto& text : invalid) {
+    ParseError error;
+    EXPECT_FALSE(Json::validate(text.first, error)) << text.first;
+    EXPECT_EQ(ParseError::INVALID_UTF8, error.code) << text.first;
+    EXPECT_EQ(text.second, error.offset) << text.first;
+  }
+  // parse() does not check it
+  ParseError error;
+  Json::parse("\"\xFF\"", error);
+  EXPECT_FALSE(error);
+}
+
+TEST(Validate, NoAllocation) {
+  string text = "[";
+  for (int i = 0; i < 1000; ++i)
+    text += R"({"id": 12345, "name": "a name long enough for the heap \u00e9\n", "tags": ["x", "y"], "score": 0.1234567890123456789012},)";
+  text += "null]";
+  // in-situ mode: the buffer is not written either
+  string copy = text;
+  Parser parser(&copy[0], copy.size());
+  ParseError error;
+  size_t before = allocCount;
+  bool ok = Json::validate(text, error) && parser.validate(error);
+  size_t allocs = allocCount - before;
+  EXPECT_TRUE(ok) << error.str();
+  EXPECT_EQ(0u, allocs);
+  EXPECT_EQ(text, copy);
+}
+
+TEST(Ndjson, Read) {
+  // several batches of lines, with blank and invalid ones
+  string text;
+  for (int i = 0; i < 10000; ++i) {
+    if (i % 100 == 7) text += " \r\n";
+    else if (i % 1000 == 3) text += "{\"id\": \n";
+    else text += "{\"id\": " + to_string(i) + ", \"pad\": \"" + string(i % 50, 'x') + "\"}\r\n";
+  }
+  text += "[1]";  // no final line end
+  auto check = [](NdjsonRecord& record) {
+    if (record.line == 10000) EXPECT_EQ(parseOk("[1]"), record.value);
+    else if (record.line % 1000 == 3) EXPECT_NE("", record.errmsg);
+    else EXPECT_EQ(record.line, static_cast<size_t>(record.value["id"].toInt64()));
+  };
+
+  vector<size_t> lines;
+  NdjsonReader(4).read(text, [&](NdjsonRecord& record) {
+    check(record);
+    lines.push_back(record.line);
+  });
+  EXPECT_EQ(9901u, lines.size());
+  EXPECT_TRUE(is_sorted(lines.begin(), lines.end()));
+
+  mutex m;
+  vector<size_t> unordered;
+  NdjsonReader(4).read(text, [&](NdjsonRecord& record) {
+    check(record);
+    lock_guard<mutex> lock(m);
+    unordered.push_back(record.line);
+  }, false);
+  sort(unordered.begin(), unordered.end());
+  EXPECT_EQ(lines, unordered);
+
+  // the same with a single thread, and from a file
+  vector<size_t> single;
+  NdjsonReader(1).read(text, [&](NdjsonRecord& record) { single.push_back(record.line); });
+  EXPECT_EQ(lines, single);
+  char path[] = "/tmp/ndjsonXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(static_cast<ssize_t>(text.size()), write(fd, text.data(), text.size()));
+  close(fd);
+  vector<size_t> fromFile;
+  NdjsonReader(3).readFile(path, [&](NdjsonRecord& record) { fromFile.push_back(record.line); });
+  unlink(path);
+  EXPECT_EQ(lines, fromFile);
+  EXPECT_THROW(NdjsonReader().readFile(path, [](NdjsonRecord&) {}), JsonException);
+
+  // exceptions of the callback stop the reading
+  size_t count = 0;
+  EXPECT_THROW(NdjsonReader(4).read(text, [&](NdjsonRecord&) {
+    if (++count == 5000) throw runtime_error("stop");
+  }), runtime_error);
+  EXPECT_EQ(5000u, count);
+}
+
+TEST(Ndjson, SpawnFailure) {
+  // numbers, whose parsing does not allocate: the calling thread parses
+  // batches too when the records are not ordered
+  string text;
+  for (int i = 0; i < 60000; ++i) text += to_string(i) + "\n";
+  // each allocation of the calling thread fails in turn (the batches, the
+  // workers, the state of each thread): all the records are delivered by
+  // the threads that could be started, or read() throws
+  for (bool ordered : {true, false}) {
+    vector<size_t> lines;
+    lines.reserve(60000);
+    mutex m;
+    for (long k = 0;; ++k) {
+      lines.clear();
+      bool threw = false;
+      allocsBeforeFailure = k;
+      try {
+        NdjsonReader(4).read(text, [&](NdjsonRecord& record) {
+          lock_guard<mutex> lock(m);
+          lines.push_back(record.line);
+        }, ordered);
+      } catch (bad_alloc&) {
+        threw = true;
+      }
+      bool failed = allocsBeforeFailure < 0;
+      allocsBeforeFailure = -1;
+      if (!threw) {
+        EXPECT_EQ(60000u, lines.size()) << k;
+        if (!ordered) sort(lines.begin(), lines.end());
+        EXPECT_TRUE(lines.size() == 60000 && lines.back() == 59999 && is_sorted(lines.begin(), lines.end())) << k;
+      }
+      if (!failed) break;
+    }
+  }
+}
+
+TEST(Parallel, SpawnFailure) {
+  // each allocation of the calling thread fails in turn: the workers
+  // vector, then the state of each thread. every call is made once,
+  // by the threads that could be started, or none if nothing started.
+  vector<atomic<int>> calls(1000);
+  for (long k = 0;; ++k) {
+    for (auto& c : calls) c = 0;
+    bool threw = false;
+    allocsBeforeFailure = k;
+    try {
+      forEachParallel(4, calls.size(), [&](size_t i) { ++calls[i]; });
+    } catch (bad_alloc&) {
+      threw = true;
+    }
+    bool failed = allocsBeforeFailure < 0;
+    allocsBeforeFailure = -1;
+    size_t once = count_if(calls.begin(), calls.end(), [](const atomic<int>& c) { return c == 1; });
+    EXPECT_EQ(threw ? 0 : calls.size(), once) << k;
+    if (!failed) break;
+  }
+}
+
+TEST(Parallel, Array) {
+  // elements with strings hiding separators, nested containers and escapes
+  string text = " [\n";
+  for (int i = 0; i < 20000; ++i) {
+    if (i) text += ",\n";
+    if (i % 3 == 0) text += "{\"id\": " + to_string(i) + ", \"s\": \"a,]}\\\"[{\\\\\", \"v\": [1.5, {\"x\": []}]}";
+    else if (i % 3 == 1) text += "[\"" + string(i % 40, ',') + "\", null, true]";
+    else text += to_string(i * 0.25);
+  }
+  text += "\n] ";
+  string serialErr, parallelErr;
+  Json serial = Json::parse(text, serialErr);
+  ASSERT_EQ("", serialErr);
+  EXPECT_EQ(serial, Json::parseParallel(text, parallelErr, 4));
+  EXPECT_EQ("", parallelErr);
+  EXPECT_EQ(serial, Json::parseParallel(text, parallelErr, 1));
+
+  // whatever goes wrong, errors are those of the serial parser
+  auto same = [](const string& doc) {
+    string serialErr, parallelErr;
+    Json serial = Json::parse(doc, serialErr);
+    EXPECT_EQ(serial, Json::parseParallel(doc, parallelErr, 4));
+    EXPECT_EQ(serialErr, parallelErr);
+  };
+  for (size_t pos : {text.size() / 3, text.size() / 2, text.size() - 4}) {
+    for (char ch : {',', ']', '}', '"', '\\', '{', 'x', '\0'}) {
+      string doc = text;
+      doc[pos] = ch;
+      same(doc);
+    }
+  }
+  same(text + "x");
+  same(text + string(1, '\0') + "x");
+  same(text.substr(0, text.size() - 3));
+  same(text.substr(0, text.size() - 3) + "}");
+  same(text.substr(0, text.size() - 3) + ",]");
+  same("[" + text + "]");
+  same("[ ]");
+  same("");
+}
+
+TEST(Lazy, Navigate) {
+  string text = R"( {"meta": {"id": 42, "tags": ["a", "b,]"], "empty": [], "none": {}},
+    "items": [1, "x\"y", [2, [3]], {"k": null}, -1.5e3, true],
+    "escaped": "v", "dup": 1, "s": "{[", "dup": 2} )";
+  LazyDocument doc(text);
+  Json json = parseOk(text);
+  LazyValue root = doc.root();
+  EXPECT_EQ(JsonType::tOBJ, root.type());
+  EXPECT_EQ(5u, root.size());     // "dup" counts once
+  EXPECT_EQ(json.size(), root.size());
+  EXPECT_EQ(json, root.get());
+  EXPECT_EQ(42, root["meta"]["id"].get().toInt64());
+  EXPECT_EQ(json["meta"]["tags"], root["meta"]["tags"].get());
+  EXPECT_EQ("b,]", root["meta"]["tags"][1].get().toString());
+  EXPECT_EQ(0u, root["meta"]["empty"].size());
+  EXPECT_EQ(0u, root["meta"]["none"].size());
+  EXPECT_EQ(JsonType::tARRAY, root["items"].type());
+  EXPECT_EQ(6u, root["items"].size());
+  for (size_t i = 0; i < 6; ++i) {
+    EXPECT_EQ(json["items"][i], root["items"][i].get());
+    EXPECT_EQ(json["items"][i].type(), root["items"][i].type());
+  }
+  EXPECT_EQ(3, root["items"][2][1][0].get().toDouble());
+  EXPECT_EQ("v", root["escaped"].get().toString());
+  EXPECT_EQ(2, root["dup"].get().toInt64());
+  EXPECT_EQ("{[", root["s"].get().toString());
+  EXPECT_EQ("[3]", root["items"][2][1].raw().str());
+
+  EXPECT_THROW(root["missing"], JsonException);
+  EXPECT_THROW(root["items"][6], JsonException);
+  EXPECT_THROW(root["items"]["a"], JsonException);
+  EXPECT_THROW(root[0], JsonException);
+
+  // scalars at the root
+  EXPECT_EQ(parseOk("1.5"), LazyDocument(" 1.5 ").root().get());
+  EXPECT_EQ(0u, LazyDocument("\"a\"").root().size());
+  // the same key written differently
+  EXPECT_EQ(2u, LazyDocument(R"({"a": 1, "\u0061": 2, "b": 3})").root().size());
+  // keys are not copied to be counted
+  string wide = "{";
+  for (int i = 0; i < 10000; ++i) wide += "\"a key long enough for the heap " + to_string(i % 5000) + "\": 1,";
+  wide.back() = '}';
+  LazyDocument wideDoc(wide);
+  size_t before = allocCount;
+  size_t members = wideDoc.root().size();
+  size_t allocs = allocCount - before;
+  EXPECT_EQ(5000u, members);
+  EXPECT_LT(allocs, 100u);
+
+  // unbalanced brackets are reported at once, with the error of the parser
+  auto parseError = [](const string& text) {
+    string errMsg;
+    Json::parse(text, errMsg);
+    return errMsg;
+  };
+  auto construct = [](const string& text) {
+    try {
+      LazyDocument doc(text);
+    } catch (JsonException& err) {
+      return string(err.what());
+    }
+    return string();
+  };
+  EXPECT_EQ(parseError("[1, {]"), construct("[1, {]"));
+  EXPECT_EQ(parseError("[[1]"), construct("[[1]"));
+  EXPECT_EQ(parseError("{\"a\": 1}}"), construct("{\"a\": 1}}"));
+  // other errors only when the part is accessed
+  LazyDocument bad(R"({"a": [1, 2,], "b": tru, "c": 1})");
+  EXPECT_EQ(1, bad.root()["c"].get().toDouble());
+  EXPECT_THROW(bad.root()["a"].size(), JsonException);
+  EXPECT_THROW(bad.root()["b"].get(), JsonException);
+  EXPECT_THROW(bad.root().get(), JsonException);
+  EXPECT_THROW(LazyDocument("").root().get(), JsonException);
+}
+
+TEST(Path, Pointer) {
+  // examples of RFC 6901
+  Json json = parseOk(R"({"foo": ["bar", "baz"], "": 0, "a/b": 1, "c%d": 2, "e^f": 3, "g|h": 4,
+                          "i\\j": 5, "k\"l": 6, " ": 7, "m~n": 8})");
+  EXPECT_EQ(&json, JsonPointer("").find(json));
+  EXPECT_EQ(json["foo"], *JsonPointer("/foo").find(json));
+  EXPECT_EQ("bar", JsonPointer("/foo/0").find(json)->toString());
+  const char* pointers[] = {"/", "/a~1b", "/c%d", "/e^f", "/g|h", "/i\\j", "/k\"l", "/ ", "/m~0n"};
+  for (int i = 0; i < 9; ++i) {
+    const Json* found = JsonPointer(pointers[i]).find(json);
+    ASSERT_NE(nullptr, found) << pointers[i];
+    EXPECT_EQ(i, found->toDouble());
+  }
+
+  // misses are nullptr, not exceptions
+  EXPECT_EQ(nullptr, JsonPointer("/foo/2").find(json));
+  EXPECT_EQ(nullptr, JsonPointer("/foo/01").find(json));
+  EXPECT_EQ(nullptr, JsonPointer("/foo/-").find(json));
+  EXPECT_EQ(nullptr, JsonPointer("/missing").find(json));
+  EXPECT_EQ(nullptr, JsonPointer("/foo/0/x").find(json));
+  EXPECT_THROW(JsonPointer("foo"), JsonException);
+  EXPECT_THROW(JsonPointer("/a~2"), JsonException);
+  EXPECT_THROW(JsonPointer("/a~"), JsonException);
+
+  // the pointer is reusable and gives mutable access
+  JsonPointer first("/foo/0");
+  *first.find(json) = Json(1);
+  EXPECT_EQ(1, json["foo"][0].toInt64());
+  Json other = parseOk(R"({"foo": [true]})");
+  EXPECT_TRUE(first.find(other)->toBool());
+}
+
+TEST(Path, Query) {
+  Json json = parseOk(R"({"store": {"book": [
+      {"author": "a", "price": 8},
+      {"author": "b", "price": 12, "isbn": "x"},
+      {"author": "c", "price": 9},
+      {"author": "d", "price": 22, "isbn": "y"}]},
+    "a b": {"it's": [0, 1, 2, 3, 4, 5]}})");
+  auto select = [&json](const char* path) {
+    vector<const Json*> out;
+    JsonPath(path).evaluate(json, out);
+    string result;
+    for (const Json* val : out) result += (result.empty() ? "" : " ") + val->serialize();
+    return result;
+  };
+  EXPECT_EQ(json.serialize(), select("$"));
+  EXPECT_EQ("\"a\" \"b\" \"c\" \"d\"", select("$.store.book[*].author"));
+  EXPECT_EQ("\"x\" \"y\"", select("$.store.book[*].isbn"));
+  EXPECT_EQ("22", select("$.store.book[-1].price"));
+  EXPECT_EQ("8", select("$['store'][\"book\"][0]['price']"));
+  EXPECT_EQ("", select("$.store.book[4]"));
+  EXPECT_EQ("", select("$.store.book.author"));
+  EXPECT_EQ("1 2 3 4 5", select("$['a b']['it\\'s'][1:]"));
+  EXPECT_EQ("0 2 4", select("$['a b']['it\\'s'][::2]"));
+  EXPECT_EQ("5 4 3", select("$['a b']['it\\'s'][:-4:-1]"));
+  EXPECT_EQ("3 4", select("$['a b']['it\\'s'][-3:-1]"));
+  EXPECT_EQ("", select("$['a b']['it\\'s'][4:2]"));
+  EXPECT_EQ("0 1 2 3 4 5", select("$['a b']['it\\'s'][-100:100]"));
+  EXPECT_EQ("5 4 3 2 1 0", select("$['a b'].*[::-1]"));
+
+  JsonPath price("$.store.book[*].price");
+  EXPECT_EQ(8, price.first(json)->toDouble());
+  EXPECT_EQ(nullptr, JsonPath("$.store.none").first(json));
+
+  for (const char* path : {"", "store", "$.", "$..a", "$[", "$[]", "$[1", "$['a]", "$[1:2:0]", "$[-]", "$.a b"})
+    EXPECT_THROW(JsonPath{path}, JsonException) << path;
+}
+
+TEST(Path, Filter) {
+  string text = R"({"id": 7, "meta": {"user": {"name": "x", "age": 3}, "tags": ["a", "b", "c"]},
+    "payload": {"big": [1, 2, {"deep": [true]}], "s": "é"}, "list": [{"k": 1}, {"k": 2}, {"k": 3}],
+    "scalar": 1})";
+  Json full = parseOk(text);
+  vector<JsonPointer> pointers = {JsonPointer("/id"), JsonPointer("/meta/user/name"), JsonPointer("/meta/tags/1"),
+                                  JsonPointer("/list/1/k"), JsonPointer("/payload"), JsonPointer("/missing/x"),
+                                  JsonPointer("/scalar/x")};
+  PathFilter filter(pointers);
+  string errmsg;
+  Json json = filter.parse(text, errmsg);
+  ASSERT_EQ("", errmsg);
+  EXPECT_EQ(parseOk(R"({"id": 7, "meta": {"user": {"name": "x"}, "tags": [null, "b"]},
+    "payload": {"big": [1, 2, {"deep": [true]}], "s": "é"}, "list": [null, {"k": 2}]})"), json);
+  // the pointers find the same values as in the whole document
+  for (const JsonPointer& pointer : pointers) {
+    const Json* expect = pointer.find(full);
+    const Json* actual = pointer.find(json);
+    if (expect) {
+      ASSERT_NE(nullptr, actual);
+      EXPECT_EQ(*expect, *actual);
+    } else EXPECT_EQ(nullptr, actual);
+  }
+
+  // the root, and nothing
+  EXPECT_EQ(full, PathFilter({JsonPointer("")}).parse(text, errmsg));
+  EXPECT_EQ(parseOk("{}"), PathFilter({}).parse(text, errmsg));
+  EXPECT_EQ(parseOk("null"), PathFilter({JsonPointer("/a")}).parse("1", errmsg));
+  EXPECT_EQ(parseOk("[null, [null, 2]]"), PathFilter({JsonPointer("/1/1")}).parse("[[0], [1, 2, 3], 4]", errmsg));
+  EXPECT_EQ("", errmsg);
+
+  // values that are skipped are still validated
+  for (const char* bad : {R"({"id": 1, "other": [1, tru]})", R"({"other": "\x"})", R"({"id": 1} 2)", R"({"id": 1)"}) {
+    string filterErr, parseErr;
+    filter.parse(bad, filterErr);
+    Json::parse(bad, parseErr);
+    EXPECT_EQ(parseErr, filterErr);
+    EXPECT_NE("", filterErr);
+  }
+}
+
+TEST(Move, Construction) {
+  // the containers given to the ctors are taken over: their elements are not copied
+  Json::array_t arr;
+  Json::object_t obj;
+  vector<Json> vec;
+  for (int i = 0; i < 100; ++i) {
+    arr.push_back(Json("string number " + to_string(i)));
+    obj.emplace(String("key number " + to_string(i)), Json("string number " + to_string(i)));
+    vec.push_back(Json("string number " + to_string(i)));
+  }
+  size_t before = allocCount;
+  Json fromArray(std::move(arr));
+  Json fromObject(std::move(obj));
+  EXPECT_EQ(2u, allocCount - before);   // one container each
+  before = allocCount;
+  Json fromVector(std::move(vec));
+  EXPECT_EQ(2u, allocCount - before);   // the array and its buffer
+  before = allocCount;
+  Json moved(std::move(fromArray));
+  EXPECT_EQ(0u, allocCount - before);
+  EXPECT_EQ(100u, moved.size());
+  EXPECT_EQ(moved, fromVector);
+  EXPECT_EQ(100u, fromObject.size());
+  EXPECT_EQ("string number 7", fromObject["key number 7"].toString());
+  before = allocCount;
+  Json copy(moved);
+  EXPECT_EQ(0u, allocCount - before);       // shared until it is written to
+
+  // parsing builds each node once: one array and its buffer per level,
+  // one object, its members and a key per level, whatever the depth
+  auto parseAllocs = [](const string& open, const string& close, int depth) {
+    string text;
+    for (int i = 0; i < depth; ++i) text += open;
+    text += "\"a string long enough to be allocated\"";
+    for (int i = 0; i < depth; ++i) text += close;
+    string errmsg;
+    size_t before = allocCount;
+    Json json = Json::parse(text, errmsg);
+    size_t allocs = allocCount - before;
+    EXPECT_EQ("", errmsg);
+    return allocs;
+  };
+  size_t arrays = parseAllocs("[", "]", 200) - parseAllocs("[", "]", 100);
+  EXPECT_GE(arrays, 200u);
+  EXPECT_LE(arrays, 205u);      // and the growth of the parser's stack
+  size_t objects = parseAllocs("{\"a key long enough to be allocated\": ", "}", 200) -
+                   parseAllocs("{\"a key long enough to be allocated\": ", "}", 100);
+  EXPECT_GE(objects, 300u);
+  EXPECT_LE(objects, 305u);
+}
+
+TEST(Copy, OnWrite) {
+  Json doc = parseOk(R"({"name": "a string long enough to be shared", "list": [1, [2, 3], {"k": "v"}], "n": 1})");
+  Json pristine = parseOk(doc.serialize());
+  // copies share everything
+  size_t before = allocCount;
+  Json copy = doc;
+  Json again(copy);
+  EXPECT_EQ(0u, allocCount - before);
+  EXPECT_EQ(&doc.toObject(), &copy.toObject());
+  EXPECT_EQ(doc["name"].toString().data(), again["name"].toString().data());
+
+  // writing to a copy leaves the others unchanged
+  copy["list"][1][0] = Json("changed");
+  EXPECT_EQ("changed", copy["list"][1][0].toString());
+  EXPECT_EQ(pristine, doc);
+  EXPECT_EQ(pristine, again);
+  EXPECT_NE(&doc.toObject(), &copy.toObject());
+  // only the containers on the way were copied
+  EXPECT_EQ(&doc.toObject().at(String::view("list")).toArray()[2].toObject(),
+            &copy.toObject().at(String::view("list")).toArray()[2].toObject());
+
+  // a reference handed out before a copy does not write to the copy
+  Json& n = doc["n"];
+  Json snapshot = doc;
+  n = Json(2);
+  EXPECT_EQ(2, doc["n"].toInt64());
+  EXPECT_EQ(1, snapshot["n"].toInt64());
+  Json* list = JsonPointer("/list/0").find(doc);
+  Json later = doc;
+  *list = Json(false);
+  EXPECT_FALSE(doc["list"][0].toBool());
+  EXPECT_EQ(1, later["list"][0].toInt64());
+
+  // values in an arena are copied to the heap
+  Document document;
+  string errmsg;
+  document.parse(R"({"k": ["v"]})", errmsg);
+  Json heap = document.root();
+  document.parse("1", errmsg);
+  EXPECT_EQ("v", heap["k"][0].toString());
+
+  // copies are handed to threads, which write to theirs
+  vector<thread> threads;
+  vector<Json> results(8, Json(nullptr));
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&pristine, &results, t] {
+      Json mine = pristine;
+      for (int i = 0; i < 100; ++i) {
+        Json tmp = mine;
+        tmp["list"][1][1] = Json(t);
+        mine = tmp;
+      }
+      results[t] = mine;
+    });
+  }
+  for (thread& th : threads) th.join();
+  for (int t = 0; t < 8; ++t) EXPECT_EQ(t, results[t]["list"][1][1].toInt64());
+  EXPECT_EQ(3, pristine["list"][1][1].toInt64());
+}
+
+TEST(Object, Order) {
+  // members keep the order of the document, below and above the index threshold
+  for (int n : {3, 16, 17, 100}) {
+    string text = "{ ";
+    for (int i = n; i > 0; --i) text += (i == n ? "\"k" : ", \"k") + to_string(i) + "\": " + to_string(i);
+    text += " }";
+    Json json = parseOk(text);
+    ASSERT_EQ(static_cast<size_t>(n), json.size());
+    EXPECT_EQ(text, json.serialize());
+    int expect = n;
+    for (const auto& member : json.toObject()) {
+      EXPECT_EQ("k" + to_string(expect), StringView(member.first).str());
+      EXPECT_EQ(expect--, member.second.toInt64());
+    }
+    for (int i = 1; i <= n; ++i) EXPECT_EQ(i, json["k" + to_string(i)].toInt64());
+    EXPECT_THROW(json["k0"], out_of_range);
+    EXPECT_EQ(json.toObject().end(), json.toObject().find("k"));
+  }
+
+  // equality does not depend on the order
+  EXPECT_EQ(parseOk(R"({"a": 1, "b": [2]})"), parseOk(R"({"b": [2], "a": 1})"));
+  EXPECT_NE(parseOk(R"({"a": 1, "b": [2]})"), parseOk(R"({"b": [2], "c": 1})"));
+
+  // an object built member by member, in an arena and on the heap
+  Arena arena;
+  for (Arena* a : {static_cast<Arena*>(nullptr), &arena}) {
+    Json::object_t obj{Json::object_t::allocator_type(a)};
+    for (int i = 0; i < 40; ++i) {
+      EXPECT_TRUE(obj.emplace(String("key" + to_string(i), a), Json(i)).second);
+      EXPECT_FALSE(obj.emplace(String("key" + to_string(i / 2), a), Json(-1)).second);
+    }
+    EXPECT_EQ(40u, obj.size());
+    for (int i = 0; i < 40; ++i) EXPECT_EQ(i, obj.at("key" + to_string(i)).toInt64());
+    Json json(std::move(obj));
+    Json copy = json;
+    EXPECT_EQ(39, copy["key39"].toInt64());
+  }
+}
+
+TEST(Key, Intern) {
+  // keys longer than String::kInlineCapacity, shorter ones are never allocated
+  const string id = "identifier of the record", stamp = "the timestamp of the record", nested = "nested values of the record";
+  string text = "[";
+  for (int i = 0; i < 1000; ++i)
+    text += string(i ? "," : "") + "{\"" + id + "\": " + to_string(i) + ", \"" + stamp + "\": \"2024\", \"" + nested +
+            "\": {\"" + id + "\": 1}}";
+  text += "]";
+  string errmsg;
+  size_t before = allocCount;
+  Json plain = Json::parse(text, errmsg);
+  size_t plainAllocs = allocCount - before;
+
+  KeyPool keys;
+  before = allocCount;
+  Json json = Json::parse(text, errmsg, keys);
+  size_t internedAllocs = allocCount - before;
+  EXPECT_EQ("", errmsg);
+  EXPECT_EQ(plain, json);
+  EXPECT_EQ(3u, keys.size());
+  // four keys per record are not allocated any more, only those of the pool
+  EXPECT_GE(plainAllocs - internedAllocs, 3980u);
+
+  // every key is the one stored in the pool, it can be compared by address
+  String pooled = keys.intern(id);
+  for (const Json& record : json.toArray()) {
+    EXPECT_EQ(pooled.data(), record.toObject().begin()->first.data());
+    EXPECT_EQ(pooled.data(), record.toObject().find(pooled)->first.data());
+    EXPECT_EQ(pooled.data(), record[nested].toObject().begin()->first.data());
+  }
+  // the pool serves other documents, and the keys outlive it
+  Json other = Json::parse("{\"" + id + R"(": 2, "a key added by another document": 3})", errmsg, keys);
+  EXPECT_EQ(pooled.data(), other.toObject().begin()->first.data());
+  EXPECT_EQ(4u, keys.size());
+  keys.clear();
+  EXPECT_EQ(3, other["a key added by another document"].toInt64());
+  EXPECT_EQ(999, json[999][id].toInt64());
+
+  // short keys are not stored
+  Json shortKeys = Json::parse(R"({"a": 1, "b": 2})", errmsg, keys);
+  EXPECT_EQ(0u, keys.size());
+  EXPECT_EQ(2, shortKeys["b"].toInt64());
+
+  // beyond its capacity the pool stops sharing
+  KeyPool small(1);
+  Json bounded = Json::parse(R"([{"the first key of the record": 1, "the second key of the record": 2},)"
+                             R"( {"the first key of the record": 3, "the second key of the record": 4}])", errmsg, small);
+  EXPECT_EQ(1u, small.size());
+  EXPECT_EQ(bounded[0].toObject().begin()->first.data(), bounded[1].toObject().begin()->first.data());
+  EXPECT_NE((bounded[0].toObject().begin() + 1)->first.data(), (bounded[1].toObject().begin() + 1)->first.data());
+  EXPECT_EQ(4, bounded[1]["the second key of the record"].toInt64());
+}
+
+TEST(Short, Strings) {
+  // up to kInlineCapacity chars are stored in the String, a char more goes to the heap
+  string fits(String::kInlineCapacity, 'x'), over = fits + 'x';
+  size_t before = allocCount;
+  String inlined(fits);
+  String inlinedCopy(inlined);
+  String moved(std::move(inlinedCopy));
+  size_t inlineAllocs = allocCount - before;
+  String heap(over);
+  String shared(heap);
+  size_t heapAllocs = allocCount - before - inlineAllocs;
+  EXPECT_EQ(0u, inlineAllocs);
+  EXPECT_EQ(1u, heapAllocs);
+  EXPECT_EQ(fits, StringView(moved).str());
+  EXPECT_EQ(0u, inlinedCopy.size());
+  EXPECT_NE(inlined.data(), moved.data());
+  EXPECT_EQ(heap.data(), shared.data());
+  shared = inlined;
+  EXPECT_EQ(fits, StringView(shared).str());
+  EXPECT_EQ(over, StringView(heap).str());
+
+  // a view borrows any size, its copies own their chars
+  String borrowed = String::view(over);
+  String shortView = String::view(StringView(over.data(), 5));
+  EXPECT_EQ(over.data(), borrowed.data());
+  before = allocCount;
+  String shortOwned(shortView);
+  inlineAllocs = allocCount - before;
+  String owned(borrowed);
+  heapAllocs = allocCount - before - inlineAllocs;
+  EXPECT_EQ(0u, inlineAllocs);
+  EXPECT_EQ(1u, heapAllocs);
+  EXPECT_NE(over.data(), owned.data());
+  EXPECT_EQ("xxxxx", StringView(shortOwned).str());
+
+  // short strings and keys cost no allocation: parsing them costs as much as
+  // parsing numbers in their place
+  auto parseAllocs = [](const string& text) {
+    string errmsg;
+    size_t before = allocCount;
+    Json json = Json::parse(text, errmsg);
+    size_t allocs = allocCount - before;
+    EXPECT_EQ("", errmsg);
+    return allocs;
+  };
+  string strings = R"([{"id": "1", "name": "short", "tags": "a, b"}, {"id": "2", "name": "shorter", "tags": ""}])";
+  string numbers = R"([{"id": 1, "name": 2, "tags": 3}, {"id": 4, "name": 5, "tags": 6}])";
+  EXPECT_EQ(parseAllocs(numbers), parseAllocs(strings));
+
+  // the same in an arena, and the copies outlive it
+  string errmsg;
+  Document document;
+  document.parse(strings, errmsg);
+  Json fromArena = document.root();
+  document.parse("1", errmsg);
+  EXPECT_EQ(parseOk(strings), fromArena);
+}
+
+TEST(Str2Json, DuplicateKey) {
+  // the last member wins
+  Json json = parseOk(R"({"a": [1], "b": 2, "a": {"c": 3}})");
+  EXPECT_EQ(2u, json.size());
+  EXPECT_EQ(3, json["a"]["c"].toDouble());
+}
+
 TEST(RoundTrip, literal) {
   testRoundtrip("null");
   testRoundtrip("true");
@@ -374,6 +1516,24 @@ TEST(RoundTrip, JsonNumber) {
   testRoundtrip("-1.7976931348623157e+308");
 }
 
+TEST(RoundTrip, ShortestNumber) {
+  // the shortest text that reads back as the same double
+  EXPECT_EQ("0.1", Json(0.1).serialize());
+  EXPECT_EQ("0.30000000000000004", Json(0.1 + 0.2).serialize());
+  EXPECT_EQ("-1.5", Json(-1.5).serialize());
+  EXPECT_EQ("-0", Json(-0.0).serialize());
+  EXPECT_EQ("100000000000000000000", Json(1e20).serialize());
+  EXPECT_EQ("1e+21", Json(1e21).serialize());
+  EXPECT_EQ("1e+23", Json(1e23).serialize());
+  EXPECT_EQ("0.000001", Json(1e-6).serialize());
+  EXPECT_EQ("1e-7", Json(1e-7).serialize());
+  EXPECT_EQ("1.234e-20", Json(1.234e-20).serialize());
+  EXPECT_EQ("5e-324", Json(4.9406564584124654e-324).serialize());
+  EXPECT_EQ("2.2250738585072014e-308", Json(2.2250738585072014e-308).serialize());
+  EXPECT_EQ("1.7976931348623157e+308", Json(1.7976931348623157e308).serialize());
+  EXPECT_EQ("9007199254740992", Json(9007199254740992.0).serialize());
+}
+
 TEST(RoundTrip, JsonString) {
   testRoundtrip("\"\"");
   testRoundtrip("\"Hello\"");
@@ -393,3 +1553,83 @@ TEST(RoundTrip, JsonObject) {
   //     R"({ "o": { "3": 3, "2": 2, "1": 1 }, "a": [ 1, 2, 3 ], "s": "abc", "n": null, "f": false, "t": true, "i": 123
   //     })");
 }
+
+TEST(RoundTrip, Writer) {
+  string errmsg;
+  Json json = Json::parse(R"({ "k\"ey": [ 1, "a\u0001b", { "x": null } ] })", errmsg);
+  EXPECT_EQ(R"({ "k\"ey": [ 1, "a\u0001b", { "x": null } ] })", json.serialize());
+  // appends to what is already there
+  string out = "prefix ";
+  json.serialize(out);
+  EXPECT_EQ("prefix " + json.serialize(), out);
+  // a long string goes through several buffer refills
+  string big(100000, 'x');
+  big[50000] = '\n';
+  out.clear();
+  Json(big).serialize(out);
+  EXPECT_EQ(100003u, out.size());
+  EXPECT_EQ("x\\nx", out.substr(50000, 4));
+  // writing again after a flush
+  StringWriter writer(out);
+  Json(true).serialize(writer);
+  writer.flush();
+  EXPECT_EQ("true", out.substr(out.size() - 4));
+  Json(nullptr).serialize(writer);
+  writer.flush();
+  EXPECT_EQ("truenull", out.substr(out.size() - 8));
+}
+
+TEST(RoundTrip, ChunkWriter) {
+  string errmsg;
+  string text = "[ ";
+  for (int i = 0; i < 100; ++i) text += (i ? ", " : "") + string("{ \"id\": [ ") + to_string(i) + ", \"abc\" ] }";
+  text += " ]";
+  Json json = Json::parse(text, errmsg);
+  ASSERT_EQ(text, json.serialize());
+  // chunks are bounded whatever the size of the document
+  string chunks;
+  size_t count = 0;
+  CallbackWriter writer([&](const char* data, size_t n) {
+    EXPECT_LE(n, 64u);
+    chunks.append(data, n);
+    ++count;
+  }, 64);
+  json.serialize(writer);
+  writer.flush();
+  EXPECT_EQ(text, chunks);
+  EXPECT_EQ((text.size() + 63) / 64, count);
+
+  ostringstream os;
+  os << json;
+  EXPECT_EQ(text, os.str());
+  // padded like a string
+  ostringstream padded;
+  padded << setw(5) << Json(1) << '|' << left << setfill('.') << setw(6) << Json("ab") << '|' << setw(2) << json.size();
+  EXPECT_EQ("    1|\"ab\"..|100", padded.str());
+  // a small value is printed without allocating
+  struct FixedBuffer : streambuf {
+    char data[64];
+    FixedBuffer() { setp(data, data + sizeof(data)); }
+    string str() const { return string(data, pptr() - data); }
+  } fixed;
+  ostream fixedOs(&fixed);
+  size_t before = allocCount;
+  fixedOs << Json(1) << Json(true);
+  size_t allocs = allocCount - before;
+  EXPECT_EQ(0u, allocs);
+  EXPECT_EQ("1true", fixed.str());
+
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  FdWriter fdWriter(fileno(file), 100);
+  json.serialize(fdWriter);
+  fdWriter.flush();
+  rewind(file);
+  string content(text.size() + 1, '\0');
+  content.resize(fread(&content[0], 1, content.size(), file));
+  fclose(file);
+  EXPECT_EQ(text, content);
+  FdWriter badFd(-1);
+  Json(1).serialize(badFd);
+  EXPECT_THROW(badFd.flush(), JsonException);
+}